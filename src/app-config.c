@@ -75,6 +75,7 @@ static void fm_app_config_init(FmAppConfig *cfg)
     cfg->desktop_fg.red = cfg->desktop_fg.green = cfg->desktop_fg.blue = 65535;
 
     gdk_color_parse("#3A6EA5", &cfg->desktop_bg);
+    cfg->desktop_shadow_style = FM_SHADOW_NORMAL;
 
     cfg->desktop_sort_type = GTK_SORT_ASCENDING;
     cfg->desktop_sort_by = COL_FILE_MTIME;
@@ -82,6 +83,8 @@ static void fm_app_config_init(FmAppConfig *cfg)
     cfg->wallpaper_common = TRUE;
 
     cfg->desktop_icon_size = 48;
+    cfg->layout_time_slice = 4;
+    cfg->label_cache_size = 32;
 
     cfg->show_icons = TRUE;
 }
@@ -149,6 +152,9 @@ void fm_app_config_load_from_key_file(FmAppConfig* cfg, GKeyFile* kf)
     _key_file_get_color(kf, "desktop", "desktop_bg", &cfg->desktop_bg);
     _key_file_get_color(kf, "desktop", "desktop_fg", &cfg->desktop_fg);
     _key_file_get_color(kf, "desktop", "desktop_shadow", &cfg->desktop_shadow);
+    if(fm_key_file_get_int(kf, "desktop", "desktop_shadow_style", &tmp_int) &&
+       tmp_int >= FM_SHADOW_THIN && tmp_int <= FM_SHADOW_BOLD2)
+        cfg->desktop_shadow_style = (FmShadowStyle)tmp_int;
 
     tmp = g_key_file_get_string(kf, "desktop", "desktop_font", NULL);
     g_free(cfg->desktop_font);
@@ -168,6 +174,9 @@ void fm_app_config_load_from_key_file(FmAppConfig* cfg, GKeyFile* kf)
     fm_key_file_get_bool(kf, "desktop", "arrange_icons_btt", &cfg->arrange_icons_btt);
     fm_key_file_get_bool(kf, "desktop", "arrange_icons_in_rows", &cfg->arrange_icons_in_rows);
     fm_key_file_get_int(kf, "desktop", "desktop_icon_size", &cfg->desktop_icon_size);
+    fm_key_file_get_bool(kf, "desktop", "hide_overflow_icons", &cfg->hide_overflow_icons);
+    fm_key_file_get_int(kf, "desktop", "layout_time_slice", &cfg->layout_time_slice);
+    fm_key_file_get_int(kf, "desktop", "label_cache_size", &cfg->label_cache_size);
     fm_key_file_get_bool(kf, "desktop", "show_icons", &cfg->show_icons);
 }
 
@@ -237,6 +246,7 @@ void fm_app_config_save_profile(FmAppConfig* cfg, const char* name)
         g_string_append_printf(buf, "desktop_bg=#%02x%02x%02x\n", cfg->desktop_bg.red/257, cfg->desktop_bg.green/257, cfg->desktop_bg.blue/257);
         g_string_append_printf(buf, "desktop_fg=#%02x%02x%02x\n", cfg->desktop_fg.red/257, cfg->desktop_fg.green/257, cfg->desktop_fg.blue/257);
         g_string_append_printf(buf, "desktop_shadow=#%02x%02x%02x\n", cfg->desktop_shadow.red/257, cfg->desktop_shadow.green/257, cfg->desktop_shadow.blue/257);
+        g_string_append_printf(buf, "desktop_shadow_style=%d\n", cfg->desktop_shadow_style);
         if(cfg->desktop_font && *cfg->desktop_font)
             g_string_append_printf(buf, "desktop_font=%s\n", cfg->desktop_font);
         g_string_append_printf(buf, "show_wm_menu=%d\n", cfg->show_wm_menu);
@@ -246,6 +256,9 @@ void fm_app_config_save_profile(FmAppConfig* cfg, const char* name)
         g_string_append_printf(buf, "arrange_icons_btt=%d\n", cfg->arrange_icons_btt);
         g_string_append_printf(buf, "arrange_icons_in_rows=%d\n", cfg->arrange_icons_in_rows);
         g_string_append_printf(buf, "desktop_icon_size=%d\n", cfg->desktop_icon_size);
+        g_string_append_printf(buf, "hide_overflow_icons=%d\n", cfg->hide_overflow_icons);
+        g_string_append_printf(buf, "layout_time_slice=%d\n", cfg->layout_time_slice);
+        g_string_append_printf(buf, "label_cache_size=%d\n", cfg->label_cache_size);
         g_string_append_printf(buf, "show_icons=%d\n", cfg->show_icons);
 
         path = g_build_filename(dir_path, APP_CONFIG_NAME, NULL);
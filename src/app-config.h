@@ -49,6 +49,14 @@ typedef enum
     FM_WP_TILE
 }FmWallpaperMode;
 
+typedef enum
+{
+    FM_SHADOW_THIN,
+    FM_SHADOW_NORMAL,
+    FM_SHADOW_BOLD,
+    FM_SHADOW_BOLD2
+}FmShadowStyle;
+
 typedef struct _FmAppConfig         FmAppConfig;
 typedef struct _FmAppConfigClass        FmAppConfigClass;
 
@@ -68,6 +76,8 @@ struct _FmAppConfig
     /* emit "changed::desktop_text" */
     GdkColor desktop_fg;
     GdkColor desktop_shadow;
+    /* emit "changed::desktop_shadow_style" */
+    FmShadowStyle desktop_shadow_style;
     /* emit "changed::desktop_font" */
     char* desktop_font;
 
@@ -75,6 +85,13 @@ struct _FmAppConfig
     int arrange_icons_btt;
     int arrange_icons_in_rows;
     int desktop_icon_size;
+    /* do not show the icons that do not fit on the screen */
+    gboolean hide_overflow_icons;
+    /* how long a layout may run before yielding to the main loop, in ms; 0 for no limit */
+    int layout_time_slice;
+    /* memory for the rendered labels and item tiles of all desktops, in MiB;
+       the window-sized icon layers come on top of it */
+    int label_cache_size;
 
     gboolean show_wm_menu;
     GtkSortType desktop_sort_type;
@@ -0,0 +1,110 @@
+/*
+ *      bench-rect-batch.c
+ *
+ *      Copyright (c) 2026 Vadim Ushakov
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+/*
+    Times one pass of each rect_batch_intersect() variant over 1k, 10k
+    and 100k item rects, next to a gdk_rectangle_intersect() call per
+    rect. Build with `make bench-rect-batch`.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+/* the variants are static */
+#include "rect-batch.c"
+
+/* about this many rects are tested for each timing */
+#define RECTS_PER_RUN 50000000
+
+static void _test_gdk(const GdkRectangle * rects, guint from, guint n,
+    int x1, int y1, int x2, int y2, guint32 * mask)
+{
+    GdkRectangle rect = {x1, y1, x2 - x1, y2 - y1};
+    guint i;
+    for (i = from; i < n; i++)
+    {
+        if (gdk_rectangle_intersect(&rects[i], &rect, NULL))
+            mask[i / 32] |= 1u << (i % 32);
+    }
+}
+
+static void run(const char * name, RectBatchFunc func, const GdkRectangle * rects, guint n,
+    const GdkRectangle * query, guint32 * mask, const guint32 * expected)
+{
+    guint words = RECT_BATCH_MASK_WORDS(n);
+    guint runs = RECTS_PER_RUN / n;
+    gint64 start;
+    guint i;
+
+    start = g_get_monotonic_time();
+    for (i = 0; i < runs; i++)
+    {
+        memset(mask, 0, words * sizeof(guint32));
+        func(rects, 0, n, query->x, query->y, query->x + query->width, query->y + query->height, mask);
+    }
+
+    printf("  %-8s %8.1f us per pass%s\n", name,
+        (double) (g_get_monotonic_time() - start) / runs,
+        expected && memcmp(mask, expected, words * sizeof(guint32)) != 0 ? "  MISMATCH" : "");
+}
+
+int main(void)
+{
+    static const guint sizes[] = {1000, 10000, 100000};
+    const GdkRectangle query = {600, 300, 400, 300};
+    guint s;
+
+    for (s = 0; s < G_N_ELEMENTS(sizes); s++)
+    {
+        guint n = sizes[s];
+        guint words = RECT_BATCH_MASK_WORDS(n);
+        GdkRectangle * rects = g_new(GdkRectangle, n);
+        guint32 * expected = g_new0(guint32, words);
+        guint32 * mask = g_new(guint32, words);
+        guint i;
+
+        /* icon-sized rects over a screen, a few of them empty */
+        for (i = 0; i < n; i++)
+        {
+            rects[i].x = g_random_int_range(-50, 1920);
+            rects[i].y = g_random_int_range(-50, 1080);
+            rects[i].width = g_random_int_range(0, 128);
+            rects[i].height = g_random_int_range(0, 96);
+        }
+
+        printf("%u rects:\n", n);
+        _test_gdk(rects, 0, n, query.x, query.y, query.x + query.width, query.y + query.height, expected);
+        run("gdk", _test_gdk, rects, n, &query, mask, NULL);
+        run("scalar", _test_scalar, rects, n, &query, mask, expected);
+#ifdef CPU_FEATURES_X86
+        if (cpu_features_get() & CPU_FEATURE_SSE2)
+            run("sse2", _test_sse2, rects, n, &query, mask, expected);
+        if (cpu_features_get() & CPU_FEATURE_AVX2)
+            run("avx2", _test_avx2, rects, n, &query, mask, expected);
+#endif
+
+        g_free(rects);
+        g_free(expected);
+        g_free(mask);
+    }
+
+    return 0;
+}
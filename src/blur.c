@@ -0,0 +1,258 @@
+/*
+ *      blur.c
+ *
+ *      Copyright (c) 2026 Vadim Ushakov
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+
+#include "blur.h"
+#include "cpu-features.h"
+
+#include <math.h>
+
+#ifdef CPU_FEATURES_X86
+#include <immintrin.h>
+#endif
+
+#define BLUR_MAX_RADIUS 32
+
+struct _BlurKernel
+{
+    int radius;
+    guint16 weights[BLUR_MAX_RADIUS * 2 + 1]; /* 8.8 fixed point, add up to 256 */
+    guint8 gain[256];
+};
+
+BlurKernel * blur_kernel_new(double sigma, double gain)
+{
+    BlurKernel * kernel = g_slice_new0(BlurKernel);
+    double g[BLUR_MAX_RADIUS * 2 + 1];
+    double sum = 0;
+    int total = 0;
+    int i, n;
+
+    sigma = MAX(sigma, 0.1);
+    kernel->radius = CLAMP((int) ceil(sigma * 3), 1, BLUR_MAX_RADIUS);
+    n = kernel->radius * 2 + 1;
+
+    for (i = 0; i < n; i++)
+    {
+        double d = i - kernel->radius;
+        g[i] = exp(-d * d / (2 * sigma * sigma));
+        sum += g[i];
+    }
+    for (i = 0; i < n; i++)
+    {
+        kernel->weights[i] = (guint16) floor(g[i] / sum * 256 + 0.5);
+        total += kernel->weights[i];
+    }
+    /* the rounding error goes to the center, so a flat area stays flat */
+    kernel->weights[kernel->radius] += 256 - total;
+
+    for (i = 0; i < 256; i++)
+        kernel->gain[i] = (guint8) MIN(255, (int) floor(i * gain + 0.5));
+
+    return kernel;
+}
+
+void blur_kernel_free(BlurKernel * kernel)
+{
+    if (kernel)
+        g_slice_free(BlurKernel, kernel);
+}
+
+int blur_kernel_get_radius(const BlurKernel * kernel)
+{
+    return kernel->radius;
+}
+
+/* Every function below blurs the columns of src into dst:
+   dst[y][x] = sum of weights[t] * src[y + t - radius][x].
+   A sum is at most 255 * 256 + 128, so it fits into 16 bits. */
+typedef void (*BlurColumnsFunc)(const guint8 * src, int src_stride,
+    guint8 * dst, int dst_stride, int width, int height, const BlurKernel * kernel);
+
+/* the taps of the row y that fall inside of the image */
+static inline void _get_taps(const BlurKernel * kernel, int y, int height, int * t0, int * t1)
+{
+    *t0 = MAX(0, kernel->radius - y);
+    *t1 = MIN(kernel->radius * 2, height - 1 - y + kernel->radius);
+}
+
+static inline void _blur_row_tail(const guint8 * src, int src_stride, guint8 * d,
+    int x, int width, int y, int t0, int t1, const BlurKernel * kernel)
+{
+    for (; x < width; x++)
+    {
+        const guint8 * s = src + (y - kernel->radius) * src_stride + x;
+        guint acc = 128;
+        int t;
+        for (t = t0; t <= t1; t++)
+            acc += kernel->weights[t] * s[t * src_stride];
+        d[x] = acc >> 8;
+    }
+}
+
+static void _blur_columns_scalar(const guint8 * src, int src_stride,
+    guint8 * dst, int dst_stride, int width, int height, const BlurKernel * kernel)
+{
+    int y, t0, t1;
+    for (y = 0; y < height; y++)
+    {
+        _get_taps(kernel, y, height, &t0, &t1);
+        _blur_row_tail(src, src_stride, dst + y * dst_stride, 0, width, y, t0, t1, kernel);
+    }
+}
+
+#ifdef CPU_FEATURES_X86
+
+__attribute__((target("sse2")))
+static void _blur_columns_sse2(const guint8 * src, int src_stride,
+    guint8 * dst, int dst_stride, int width, int height, const BlurKernel * kernel)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i half = _mm_set1_epi16(128);
+    int x, y, t, t0, t1;
+
+    for (y = 0; y < height; y++)
+    {
+        const guint8 * s = src + (y - kernel->radius) * src_stride;
+        guint8 * d = dst + y * dst_stride;
+        _get_taps(kernel, y, height, &t0, &t1);
+
+        for (x = 0; x + 16 <= width; x += 16)
+        {
+            __m128i lo = half, hi = half;
+            for (t = t0; t <= t1; t++)
+            {
+                __m128i p = _mm_loadu_si128((const __m128i *) (s + t * src_stride + x));
+                __m128i w = _mm_set1_epi16(kernel->weights[t]);
+                lo = _mm_add_epi16(lo, _mm_mullo_epi16(_mm_unpacklo_epi8(p, zero), w));
+                hi = _mm_add_epi16(hi, _mm_mullo_epi16(_mm_unpackhi_epi8(p, zero), w));
+            }
+            lo = _mm_srli_epi16(lo, 8);
+            hi = _mm_srli_epi16(hi, 8);
+            _mm_storeu_si128((__m128i *) (d + x), _mm_packus_epi16(lo, hi));
+        }
+
+        _blur_row_tail(src, src_stride, d, x, width, y, t0, t1, kernel);
+    }
+}
+
+/* unpack and pack work within 128-bit lanes, so the pixel order is kept */
+__attribute__((target("avx2")))
+static void _blur_columns_avx2(const guint8 * src, int src_stride,
+    guint8 * dst, int dst_stride, int width, int height, const BlurKernel * kernel)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i half = _mm256_set1_epi16(128);
+    int x, y, t, t0, t1;
+
+    for (y = 0; y < height; y++)
+    {
+        const guint8 * s = src + (y - kernel->radius) * src_stride;
+        guint8 * d = dst + y * dst_stride;
+        _get_taps(kernel, y, height, &t0, &t1);
+
+        for (x = 0; x + 32 <= width; x += 32)
+        {
+            __m256i lo = half, hi = half;
+            for (t = t0; t <= t1; t++)
+            {
+                __m256i p = _mm256_loadu_si256((const __m256i *) (s + t * src_stride + x));
+                __m256i w = _mm256_set1_epi16(kernel->weights[t]);
+                lo = _mm256_add_epi16(lo, _mm256_mullo_epi16(_mm256_unpacklo_epi8(p, zero), w));
+                hi = _mm256_add_epi16(hi, _mm256_mullo_epi16(_mm256_unpackhi_epi8(p, zero), w));
+            }
+            lo = _mm256_srli_epi16(lo, 8);
+            hi = _mm256_srli_epi16(hi, 8);
+            _mm256_storeu_si256((__m256i *) (d + x), _mm256_packus_epi16(lo, hi));
+        }
+
+        _blur_row_tail(src, src_stride, d, x, width, y, t0, t1, kernel);
+    }
+}
+
+#endif /* CPU_FEATURES_X86 */
+
+static BlurColumnsFunc _get_blur_columns(void)
+{
+    static BlurColumnsFunc func = NULL;
+
+    if (G_UNLIKELY(!func))
+    {
+        func = _blur_columns_scalar;
+#ifdef CPU_FEATURES_X86
+        CpuFeatures features = cpu_features_get();
+        /* both passes run through here, so the widest vectors win */
+        if (features & CPU_FEATURE_AVX2)
+            func = _blur_columns_avx2;
+        else if (features & CPU_FEATURE_SSE2)
+            func = _blur_columns_sse2;
+#endif
+    }
+
+    return func;
+}
+
+/* dst[x][y] = src[y][x], in blocks that stay in the cache */
+static void _transpose(const guint8 * src, int src_stride,
+    guint8 * dst, int dst_stride, int width, int height)
+{
+    int bx, by, x, y;
+    for (by = 0; by < height; by += 16)
+        for (bx = 0; bx < width; bx += 16)
+            for (y = by; y < MIN(by + 16, height); y++)
+                for (x = bx; x < MIN(bx + 16, width); x++)
+                    dst[x * dst_stride + y] = src[y * src_stride + x];
+}
+
+void blur_a8(guint8 * data, int width, int height, int stride, const BlurKernel * kernel)
+{
+    BlurColumnsFunc blur_columns = _get_blur_columns();
+    guint8 * tmp;
+    guint8 * tmp_t;
+    int x, y;
+
+    if (width <= 0 || height <= 0)
+        return;
+
+    tmp = g_malloc((gsize) width * height);
+    tmp_t = g_malloc((gsize) width * height);
+
+    /* vertical pass */
+    blur_columns(data, stride, tmp, width, width, height, kernel);
+    /* horizontal pass, as a vertical one over the transposed image */
+    _transpose(tmp, width, tmp_t, height, width, height);
+    blur_columns(tmp_t, height, tmp, height, height, width, kernel);
+    _transpose(tmp, height, data, stride, height, width);
+
+    for (y = 0; y < height; y++)
+    {
+        guint8 * row = data + y * stride;
+        for (x = 0; x < width; x++)
+            row[x] = kernel->gain[row[x]];
+    }
+
+    g_free(tmp);
+    g_free(tmp_t);
+}
@@ -0,0 +1,53 @@
+/*
+ *      blur.h
+ *
+ *      Copyright (c) 2026 Vadim Ushakov
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+
+#ifndef __BLUR_H__
+#define __BLUR_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+    A separable Gaussian blur of 8-bit alpha images, used for the label
+    shadows. Both passes run over rows, vectorized with AVX2 or SSE2
+    when the CPU has them; the horizontal one works on a transposed copy.
+*/
+
+typedef struct _BlurKernel BlurKernel;
+
+/* The result is multiplied by gain and saturated, so a blurred thin
+   stroke can stay as dark as the unblurred one. */
+BlurKernel * blur_kernel_new(double sigma, double gain);
+void blur_kernel_free(BlurKernel * kernel);
+
+/* How far the blur spreads, in pixels. The image should have that much
+   empty room around its content, since the pixels beyond the edges are
+   taken as transparent. */
+int blur_kernel_get_radius(const BlurKernel * kernel);
+
+/* Blurs a CAIRO_FORMAT_A8 image in place. */
+void blur_a8(guint8 * data, int width, int height, int stride, const BlurKernel * kernel);
+
+G_END_DECLS
+
+#endif /* __BLUR_H__ */
@@ -0,0 +1,187 @@
+/*
+ *      cell-placement-generator.c
+ *
+ *      Copyright (c) 2026 Vadim Ushakov
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "cell-placement-generator.h"
+
+void cell_placement_generator_mark_occupied(CellPlacementGenerator * self,
+    long dx, long dy, long left, long top, long right, long bottom)
+{
+    long columns = cell_placement_generator_get_columns(self);
+    long rows = cell_placement_generator_get_rows(self);
+    long axis1_length = cell_placement_generator_get_axis1_length(self);
+    long col0 = -1, col1 = -1, row0 = -1, row1 = -1;
+    long i, col, row;
+
+    if (!self->occupancy || left >= right || top >= bottom)
+        return;
+
+    /* cells are numbered from the placement origin */
+    for (i = 0; i < columns; i++)
+    {
+        long x = self->arrange_rtl ? self->right_line - self->cell_w * (i + 1) : self->left_line + self->cell_w * i;
+        if (left <= x + dx && x + dx < right)
+        {
+            if (col0 < 0)
+                col0 = i;
+            col1 = i;
+        }
+    }
+
+    for (i = 0; i < rows; i++)
+    {
+        long y = self->arrange_btt ? self->bottom_line - self->cell_h * (i + 1) : self->top_line + self->cell_h * i;
+        if (top <= y + dy && y + dy < bottom)
+        {
+            if (row0 < 0)
+                row0 = i;
+            row1 = i;
+        }
+    }
+
+    if (col0 < 0 || row0 < 0)
+        return;
+
+    for (row = row0; row <= row1; row++)
+    {
+        for (col = col0; col <= col1; col++)
+        {
+            long k = self->arrange_in_rows ? row * axis1_length + col : col * axis1_length + row;
+            self->occupancy[k >> 6] |= (guint64) 1 << (k & 63);
+        }
+    }
+}
+
+static long _cell_placement_generator_find_free_cell(const guint64 * map, long from, long n)
+{
+    long w = from >> 6;
+    long n_words = (n + 63) >> 6;
+    guint64 word;
+
+    if (from >= n)
+        return -1;
+
+    word = ~map[w] & (~(guint64) 0 << (from & 63));
+    for (;;)
+    {
+        if (word)
+        {
+            long bit;
+#if defined(__GNUC__)
+            bit = (w << 6) + __builtin_ctzll(word);
+#else
+            bit = w << 6;
+            while (!(word & 1))
+            {
+                word >>= 1;
+                bit++;
+            }
+#endif
+            return bit < n ? bit : -1;
+        }
+        if (++w >= n_words)
+            return -1;
+        word = ~map[w];
+    }
+}
+
+/* moves the generator to the given cell of the current tier */
+static void _cell_placement_generator_set_cell(CellPlacementGenerator * self, long i1, long i2)
+{
+    long col = self->arrange_in_rows ? i1 : i2;
+    long row = self->arrange_in_rows ? i2 : i1;
+
+    self->_i1 = i1;
+    self->_i2 = i2;
+
+    if (self->arrange_rtl)
+        self->_x = self->right_line - self->cell_w * (col + 1);
+    else
+        self->_x = self->left_line + self->cell_w * col;
+
+    if (self->arrange_btt)
+        self->_y = self->bottom_line - self->cell_h * (row + 1);
+    else
+        self->_y = self->top_line + self->cell_h * row;
+}
+
+void cell_placement_generator_skip_occupied(CellPlacementGenerator * self)
+{
+    long n, axis1_length, k, free_k;
+
+    if (!self->occupancy)
+        return;
+
+    n = cell_placement_generator_get_tier_size(self);
+    axis1_length = cell_placement_generator_get_axis1_length(self);
+    k = self->_i2 * axis1_length + self->_i1;
+
+    free_k = _cell_placement_generator_find_free_cell(self->occupancy, k, n);
+    if (free_k == k)
+        return;
+
+    if (free_k < 0)
+    {
+        /* nothing left in this tier, continue from the start of the next one */
+        free_k = _cell_placement_generator_find_free_cell(self->occupancy, 0, n);
+        if (free_k < 0)
+            return;
+        self->tier++;
+        self->index += n - k;
+        k = 0;
+    }
+
+    self->index += free_k - k;
+    _cell_placement_generator_set_cell(self, free_k % axis1_length, free_k / axis1_length);
+    cell_placement_generator_update_xy(self);
+}
+
+void cell_placement_generator_seek(CellPlacementGenerator * self, long index)
+{
+    long tier_size = cell_placement_generator_get_tier_size(self);
+    long axis1_length = cell_placement_generator_get_axis1_length(self);
+    long k;
+
+    if (index < 0)
+        index = 0;
+
+    k = index % tier_size;
+    self->tier = index / tier_size;
+    self->index = index;
+    _cell_placement_generator_set_cell(self, k % axis1_length, k / axis1_length);
+    cell_placement_generator_update_xy(self);
+}
+
+void cell_placement_generator_get_nth(CellPlacementGenerator * self, long index,
+    long * x, long * y, long * tier)
+{
+    CellPlacementGenerator g = *self;
+    cell_placement_generator_seek(&g, index);
+    if (x)
+        *x = g.x;
+    if (y)
+        *y = g.y;
+    if (tier)
+        *tier = g.tier;
+}
@@ -46,13 +46,30 @@ typedef struct {
     /* generated position */
     long x;
     long y;
+    long index; /* number of the position since the last reset */
+
+    /* occupancy map: one bit per cell of a tier in placement order, set for blocked cells */
+    guint64 * occupancy;
 
     /* internals */
     long tier;
     long _x;
     long _y;
+    long _i1; /* cell number along axis1 */
+    long _i2; /* cell number along axis2 */
+    long _tier_dx; /* shift of each next tier */
+    long _tier_dy;
 } CellPlacementGenerator;
 
+static inline
+void _cell_placement_generator_update_tier_offsets(CellPlacementGenerator * self)
+{
+    long x_div = self->arrange_in_rows ? 24 : 16;
+    long y_div = self->arrange_in_rows ? 16 : 24;
+    self->_tier_dx = (1 + self->cell_w / x_div) * (self->arrange_rtl ? -1 : 1);
+    self->_tier_dy = (1 + self->cell_h / y_div) * (self->arrange_btt ? -1 : 1);
+}
+
 static inline
 void cell_placement_generator_set_bounding_box(CellPlacementGenerator * self,
     long left_line,
@@ -73,6 +90,7 @@ void cell_placement_generator_set_cell_size(CellPlacementGenerator * self,
 {
     self->cell_w = cell_w;
     self->cell_h = cell_h;
+    _cell_placement_generator_update_tier_offsets(self);
 }
 
 static inline
@@ -84,6 +102,35 @@ void cell_placement_generator_set_placement_rules(CellPlacementGenerator * self,
     self->arrange_in_rows = arrange_in_rows;
     self->arrange_rtl = arrange_rtl;
     self->arrange_btt = arrange_btt;
+    _cell_placement_generator_update_tier_offsets(self);
+}
+
+static inline
+long cell_placement_generator_get_columns(CellPlacementGenerator * self)
+{
+    return MAX(1, (self->right_line - self->left_line) / self->cell_w);
+}
+
+static inline
+long cell_placement_generator_get_rows(CellPlacementGenerator * self)
+{
+    return MAX(1, (self->bottom_line - self->top_line) / self->cell_h);
+}
+
+static inline
+long cell_placement_generator_get_axis1_length(CellPlacementGenerator * self)
+{
+    if (self->arrange_in_rows)
+        return cell_placement_generator_get_columns(self);
+    else
+        return cell_placement_generator_get_rows(self);
+}
+
+/* number of cells in a tier */
+static inline
+long cell_placement_generator_get_tier_size(CellPlacementGenerator * self)
+{
+    return cell_placement_generator_get_columns(self) * cell_placement_generator_get_rows(self);
 }
 
 static inline
@@ -107,6 +154,7 @@ void cell_placement_generator_reset_y(CellPlacementGenerator * self)
 static inline
 void cell_placement_generator_reset_axis1(CellPlacementGenerator * self)
 {
+    self->_i1 = 0;
     if (self->arrange_in_rows)
         return cell_placement_generator_reset_x(self);
     else
@@ -116,6 +164,7 @@ void cell_placement_generator_reset_axis1(CellPlacementGenerator * self)
 static inline
 void cell_placement_generator_reset_axis2(CellPlacementGenerator * self)
 {
+    self->_i2 = 0;
     if (self->arrange_in_rows)
         return cell_placement_generator_reset_y(self);
     else
@@ -125,29 +174,17 @@ void cell_placement_generator_reset_axis2(CellPlacementGenerator * self)
 static inline
 void cell_placement_generator_update_xy(CellPlacementGenerator * self)
 {
-    self->x = self->_x;
-    self->y = self->_y;
-    if (self->tier)
-    {
-        long x_div = 16;
-        long y_div = 24;
-        if (self->arrange_in_rows)
-        {
-            float t = x_div;
-            x_div = y_div;
-            y_div = t;
-        }
-        self->x += (1.0 + self->cell_w / x_div) * self->tier * (1 - 2 * self->arrange_rtl);
-        self->y += (1.0 + self->cell_h / y_div) * self->tier * (1 - 2 * self->arrange_btt);
-    }
+    self->x = self->_x + self->_tier_dx * self->tier;
+    self->y = self->_y + self->_tier_dy * self->tier;
 }
 
 static inline
 void cell_placement_generator_reset(CellPlacementGenerator * self)
 {
-    cell_placement_generator_reset_x(self);
-    cell_placement_generator_reset_y(self);
+    cell_placement_generator_reset_axis1(self);
+    cell_placement_generator_reset_axis2(self);
     self->tier = 0;
+    self->index = 0;
     cell_placement_generator_update_xy(self);
 }
 
@@ -192,6 +229,7 @@ int cell_placement_generator_advance_y(CellPlacementGenerator * self)
 static inline
 int cell_placement_generator_advance_axis1(CellPlacementGenerator * self)
 {
+    self->_i1++;
     if (self->arrange_in_rows)
         return cell_placement_generator_advance_x(self);
     else
@@ -201,6 +239,7 @@ int cell_placement_generator_advance_axis1(CellPlacementGenerator * self)
 static inline
 int cell_placement_generator_advance_axis2(CellPlacementGenerator * self)
 {
+    self->_i2++;
     if (self->arrange_in_rows)
         return cell_placement_generator_advance_y(self);
     else
@@ -221,9 +260,41 @@ void cell_placement_generator_advance(CellPlacementGenerator * self)
         }
     }
 
+    self->index++;
     cell_placement_generator_update_xy(self);
 }
 
+/* occupancy map */
+
+static inline
+gsize cell_placement_generator_get_occupancy_map_size(CellPlacementGenerator * self)
+{
+    return (cell_placement_generator_get_tier_size(self) + 63) / 64;
+}
+
+/* map must hold cell_placement_generator_get_occupancy_map_size() zeroed words */
+static inline
+void cell_placement_generator_set_occupancy_map(CellPlacementGenerator * self, guint64 * map)
+{
+    self->occupancy = map;
+}
+
+/* marks every cell whose point at (dx, dy) from its top-left corner
+   lies in the given rectangle as blocked */
+void cell_placement_generator_mark_occupied(CellPlacementGenerator * self,
+    long dx, long dy, long left, long top, long right, long bottom);
+
+/* Skips blocked cells in bulk, scanning the occupancy map a word at a time.
+   If every cell is blocked, stays at the current position. */
+void cell_placement_generator_skip_occupied(CellPlacementGenerator * self);
+
+/* moves the generator straight to the position with the given index */
+void cell_placement_generator_seek(CellPlacementGenerator * self, long index);
+
+/* gets the position with the given index without moving the generator */
+void cell_placement_generator_get_nth(CellPlacementGenerator * self, long index,
+    long * x, long * y, long * tier);
+
 G_END_DECLS
 
 #endif /* CELL_PLACEMENT_GENERATOR_H__ */
@@ -0,0 +1,47 @@
+/*
+ *      cpu-features.c
+ *
+ *      Copyright (c) 2026 Vadim Ushakov
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "cpu-features.h"
+
+CpuFeatures cpu_features_get(void)
+{
+    static gsize features = 0;
+
+    if (g_once_init_enter(&features))
+    {
+        /* stored plus one, since zero means not asked yet */
+        gsize found = 0;
+#ifdef CPU_FEATURES_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("sse2"))
+            found |= CPU_FEATURE_SSE2;
+        if (__builtin_cpu_supports("avx2"))
+            found |= CPU_FEATURE_AVX2;
+#endif
+        g_once_init_leave(&features, found + 1);
+    }
+
+    return (CpuFeatures) (features - 1);
+}
@@ -0,0 +1,53 @@
+/*
+ *      cpu-features.h
+ *
+ *      Copyright (c) 2026 Vadim Ushakov
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+
+#ifndef __CPU_FEATURES_H__
+#define __CPU_FEATURES_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+    Picking a SIMD variant of a function at run time: the variants are
+    compiled with __attribute__((target(...))) under CPU_FEATURES_X86,
+    and the one to call is chosen by cpu_features_get().
+*/
+
+/* target attributes need GCC 4.9 or clang */
+#if (defined(__x86_64__) || defined(__i386__)) \
+    && (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define CPU_FEATURES_X86 1
+#endif
+
+typedef enum
+{
+    CPU_FEATURE_SSE2 = 1 << 0,
+    CPU_FEATURE_AVX2 = 1 << 1
+} CpuFeatures;
+
+/* The extensions the CPU has. Only the first call asks the CPU. */
+CpuFeatures cpu_features_get(void);
+
+G_END_DECLS
+
+#endif /* __CPU_FEATURES_H__ */
@@ -30,6 +30,11 @@
 #include "app-config.h"
 #include "wallpaper-manager.h"
 #include "window-tracker.h"
+#include "text-extents-cache.h"
+#include "blur.h"
+#include "label-atlas.h"
+#include "icon-surface-cache.h"
+#include "rect-batch.h"
 
 #include <glib/gi18n.h>
 
@@ -52,26 +57,80 @@
 #define PADDING 6
 #define MARGIN  2
 
+/* below this, labels are measured in place instead of on the worker pool */
+#define MIN_BACKGROUND_LABELS 256
+
+/* the label masks are packed into pages of this size */
+#define LABEL_ATLAS_PAGE_SIZE 1024
+
 typedef struct _cached_layout_image
 {
     guint timestamp;
-    cairo_surface_t * surface;
+    int pad; /* room around the text left for the blur */
+    LabelAtlasEntry * entry; /* reset by the atlas if the entry is evicted */
 } cached_layout_image_t;
 
 static inline void cached_layout_image_invalidate(cached_layout_image_t * cache)
 {
-    if (cache->surface)
-    {
-        cairo_surface_destroy(cache->surface);
-        cache->surface = NULL;
-    }
+    if (cache->entry)
+        label_atlas_entry_free(cache->entry);
 }
 
 static inline gboolean cached_layout_image_check_timestamp(cached_layout_image_t * cache, guint timestamp)
 {
     if (cache->timestamp != timestamp)
         cached_layout_image_invalidate(cache);
-    return cache->surface != NULL;
+    return cache->entry != NULL;
+}
+
+/* The whole item (icon, label, shadow and focus) composited into one
+   surface, so an expose only has to blit it. */
+typedef struct _item_tile
+{
+    guint timestamp;
+    guint state;
+    GdkRectangle icon_rect; /* the item geometry the tile was rendered for */
+    GdkRectangle text_rect;
+    cairo_surface_t * surface;
+#if !GTK_CHECK_VERSION(3, 0, 0)
+    GdkPixmap * pixmap; /* the drawable behind surface */
+#endif
+    gsize bytes;
+    GList link; /* in item_tiles, data is NULL while the tile is not there */
+} item_tile_t;
+
+/* The tiles of all desktops, the most recently painted first. They share
+   one memory budget with the label masks, see trim_item_tiles(). */
+static GQueue item_tiles = G_QUEUE_INIT;
+static LabelAtlasStats item_tile_stats;
+
+enum
+{
+    ITEM_TILE_SELECTED = 1 << 0,
+    ITEM_TILE_FOCUSED  = 1 << 1
+};
+
+static inline void item_tile_invalidate(item_tile_t * tile)
+{
+    if (tile->link.data)
+    {
+        g_queue_unlink(&item_tiles, &tile->link);
+        tile->link.data = NULL;
+        item_tile_stats.bytes -= tile->bytes;
+        tile->bytes = 0;
+    }
+    if (tile->surface)
+    {
+        cairo_surface_destroy(tile->surface);
+        tile->surface = NULL;
+    }
+#if !GTK_CHECK_VERSION(3, 0, 0)
+    if (tile->pixmap)
+    {
+        g_object_unref(tile->pixmap);
+        tile->pixmap = NULL;
+    }
+#endif
 }
 
 struct _FmDesktopItem
@@ -79,6 +138,9 @@ struct _FmDesktopItem
     FmFileInfo* fi;
     int x; /* position of the item on the desktop */
     int y;
+    long cell_index; /* index of the placement cell, -1 if not auto-placed yet */
+    int fixed_slot; /* the index of its rect in fixed_rects; see has_fixed_rect() */
+    guint z; /* the row of the item, items are painted in this order; see sync_items_geometry() */
     GdkRectangle icon_rect;
     GdkRectangle text_rect;
 
@@ -88,14 +150,21 @@ struct _FmDesktopItem
     cached_layout_image_t cached_text;
     cached_layout_image_t cached_text_shadow;
 
+    item_tile_t tile;
+
     gboolean is_special : 1; /* is this a special item like "My Computer", mounted volume, or "Trash" */
     gboolean is_mount : 1; /* is this a mounted volume*/
     gboolean is_selected : 1;
     gboolean is_prelight : 1;
     gboolean fixed_pos : 1;
+    gboolean is_virtual : 1; /* a placeholder for an item that does not fit on the screen */
 };
 
 static void queue_layout_items(FmDesktop* desktop);
+static void queue_layout_items_from(FmDesktop* desktop, gint row);
+static void queue_draw_items(FmDesktop* desktop);
+static void queue_warm_up_labels(FmDesktop* desktop);
+static int get_item_tile_margin(void);
 
 static FmFileInfoList* _dup_selected_files(FmFolderView* fv);
 static FmPathList* _dup_selected_file_paths(FmFolderView* fv);
@@ -179,6 +248,8 @@ static char* get_config_file(FmDesktop* desktop, gboolean create_dir)
 static inline FmDesktopItem* desktop_item_new(FmFolderModel* model, GtkTreeIter* it)
 {
     FmDesktopItem* item = g_slice_new0(FmDesktopItem);
+    item->cell_index = -1;
+    item->fixed_slot = -1;
     fm_folder_model_set_item_userdata(model, it, item);
     gtk_tree_model_get(GTK_TREE_MODEL(model), it, COL_FILE_INFO, &item->fi, -1);
     fm_file_info_ref(item->fi);
@@ -192,11 +263,158 @@ static inline void desktop_item_free(FmDesktopItem* item)
 
     if (item->fi)
         fm_file_info_unref(item->fi);
+    cached_layout_image_invalidate(&item->cached_text);
+    cached_layout_image_invalidate(&item->cached_text_shadow);
+    item_tile_invalidate(&item->tile);
     g_slice_free(FmDesktopItem, item);
 }
 
+static inline void get_item_rect(FmDesktopItem* item, GdkRectangle* rect)
+{
+    gdk_rectangle_union(&item->icon_rect, &item->text_rect, rect);
+}
+
+/* the area the item paints to, including the label shadow and the focus rect */
+static inline void get_item_tile_rect(FmDesktopItem* item, GdkRectangle* rect)
+{
+    int margin = get_item_tile_margin();
+    get_item_rect(item, rect);
+    rect->x -= margin;
+    rect->y -= margin;
+    rect->width += margin * 2;
+    rect->height += margin * 2;
+}
+
+/* keep the slot of the item in items_geometry in sync with its rects */
+static inline void update_item_geometry(FmDesktop* desktop, FmDesktopItem* item)
+{
+    ItemGeometry* geometry = desktop->items_geometry;
+    /* the stale slots are set from the items by the next sync_items_geometry() */
+    if(item->z < desktop->items_geometry_stale && item->z < geometry->n_items
+     && geometry->items[item->z] == item)
+        item_geometry_set(geometry, item->z, item, &item->icon_rect, &item->text_rect,
+                          item->x, item->y, item->is_virtual ? ITEM_GEOMETRY_VIRTUAL : 0);
+}
+
+/* the rows from row on have moved, so have their slots in items_geometry */
+static inline void mark_items_geometry_stale(FmDesktop* desktop, guint row)
+{
+    desktop->items_geometry_stale = MIN(desktop->items_geometry_stale, row);
+}
+
+/* Sets the stale slots of items_geometry and item->z again from the model.
+   Call it before reading either; it is one pass however many rows have
+   been inserted or deleted since the last call. */
+static void sync_items_geometry(FmDesktop* desktop)
+{
+    static const GdkRectangle empty = {0, 0, 0, 0};
+    ItemGeometry* geometry = desktop->items_geometry;
+    GtkTreeModel* model = GTK_TREE_MODEL(desktop->model);
+    guint i = desktop->items_geometry_stale;
+    GtkTreeIter it;
+
+    if(i == G_MAXUINT)
+        return;
+    desktop->items_geometry_stale = G_MAXUINT;
+
+    item_geometry_resize(geometry, model ? gtk_tree_model_iter_n_children(model, NULL) : 0);
+    if(i >= geometry->n_items || !gtk_tree_model_iter_nth_child(model, &it, NULL, i))
+        return;
+    do
+    {
+        FmDesktopItem* item = fm_folder_model_get_item_userdata(desktop->model, &it);
+        if(item)
+        {
+            item->z = i;
+            item_geometry_set(geometry, i, item, &item->icon_rect, &item->text_rect,
+                              item->x, item->y, item->is_virtual ? ITEM_GEOMETRY_VIRTUAL : 0);
+        }
+        else
+            item_geometry_set(geometry, i, NULL, &empty, &empty, 0, 0, ITEM_GEOMETRY_VIRTUAL);
+        i++;
+    }
+    while(gtk_tree_model_iter_next(model, &it));
+}
+
+/* keep items_index in sync with the painted area of the item */
+static inline void update_item_index(FmDesktop* desktop, FmDesktopItem* item)
+{
+    GdkRectangle rect;
+    update_item_geometry(desktop, item);
+    if(item->is_virtual)
+    {
+        /* not painted while it is a placeholder */
+        item_tile_invalidate(&item->tile);
+        spatial_grid_remove(desktop->items_index, item);
+        return;
+    }
+    get_item_tile_rect(item, &rect);
+    spatial_grid_insert(desktop->items_index, item, &rect);
+}
+
+/* the slot is checked against the array, since unload_items() empties it
+   without going over the items */
+static inline gboolean has_fixed_rect(FmDesktop* desktop, FmDesktopItem* item)
+{
+    return item->fixed_slot >= 0 && (guint)item->fixed_slot < desktop->fixed_rect_items->len
+        && g_ptr_array_index(desktop->fixed_rect_items, item->fixed_slot) == item;
+}
+
+/* keep fixed_rects in sync with the rect of a fixed item */
+static inline void update_fixed_item_index(FmDesktop* desktop, FmDesktopItem* item)
+{
+    GdkRectangle rect;
+    get_item_rect(item, &rect);
+    if(has_fixed_rect(desktop, item))
+        g_array_index(desktop->fixed_rects, GdkRectangle, item->fixed_slot) = rect;
+    else
+    {
+        item->fixed_slot = desktop->fixed_rects->len;
+        g_array_append_val(desktop->fixed_rects, rect);
+        g_ptr_array_add(desktop->fixed_rect_items, item);
+    }
+}
+
+static void fix_item_pos(FmDesktop* desktop, FmDesktopItem* item)
+{
+    if(!item->fixed_pos)
+    {
+        item->fixed_pos = TRUE;
+        item->cell_index = -1;
+        desktop->fixed_items = g_list_prepend(desktop->fixed_items, item);
+    }
+    update_fixed_item_index(desktop, item);
+}
+
+static void unfix_item_pos(FmDesktop* desktop, FmDesktopItem* item)
+{
+    item->fixed_pos = FALSE;
+    desktop->fixed_items = g_list_remove(desktop->fixed_items, item);
+    if(has_fixed_rect(desktop, item))
+    {
+        /* the last rect takes its slot */
+        FmDesktopItem* last = g_ptr_array_index(desktop->fixed_rect_items, desktop->fixed_rect_items->len - 1);
+        g_array_remove_index_fast(desktop->fixed_rects, item->fixed_slot);
+        g_ptr_array_remove_index_fast(desktop->fixed_rect_items, item->fixed_slot);
+        last->fixed_slot = item->fixed_slot;
+        item->fixed_slot = -1;
+    }
+}
+
+static const char* get_text_font_key(FmDesktop* desktop)
+{
+    if(desktop->text_font_key_timestamp != desktop->pango_timestamp)
+    {
+        desktop->text_font_key = text_extents_cache_get_font_key(pango_layout_get_context(desktop->pl));
+        desktop->text_font_key_timestamp = desktop->pango_timestamp;
+    }
+    return desktop->text_font_key;
+}
+
 static void calc_item_size(FmDesktop* desktop, FmDesktopItem* item, GdkPixbuf* icon)
 {
+    item->is_virtual = FALSE;
+
     /* icon rect */
     if(icon)
     {
@@ -225,22 +443,25 @@ static void calc_item_size(FmDesktop* desktop, FmDesktopItem* item, GdkPixbuf* i
 
         pango_layout_set_height(desktop->pl, desktop->pango_text_h);
         pango_layout_set_width(desktop->pl, desktop->pango_text_w);
-        pango_layout_set_text(desktop->pl, fm_file_info_get_disp_name(item->fi), -1);
-
-        PangoRectangle _unused_rc;
-        pango_layout_get_pixel_extents(desktop->pl, &_unused_rc, &item->text_pango_logical_rect);
-        pango_layout_set_text(desktop->pl, NULL, 0);
+        text_extents_cache_measure(desktop->pl, get_text_font_key(desktop),
+            fm_file_info_get_disp_name(item->fi), &item->text_pango_logical_rect);
 
         cached_layout_image_invalidate(&item->cached_text);
         cached_layout_image_invalidate(&item->cached_text_shadow);
+        item_tile_invalidate(&item->tile);
     }
 
     item->text_rect.x = item->x + (desktop->cell_w - item->text_pango_logical_rect.width - 4) / 2;
     item->text_rect.y = item->icon_rect.y + item->icon_rect.height + item->text_pango_logical_rect.y;
     item->text_rect.width = item->text_pango_logical_rect.width + 4;
     item->text_rect.height = item->text_pango_logical_rect.height + 4;
+
+    update_item_index(desktop, item);
 }
 
+static gboolean apply_layout_snapshot(FmDesktop* self);
+static void queue_layout_revalidation(FmDesktop* desktop);
+
 void load_items(FmDesktop* desktop)
 {
     GtkTreeIter it;
@@ -268,11 +489,10 @@ void load_items(FmDesktop* desktop)
             if(g_key_file_has_group(kf, name))
             {
                 gtk_tree_model_get(model, &it, FM_FOLDER_MODEL_COL_ICON_WITH_THUMBNAIL, &icon, -1);
-                desktop->fixed_items = g_list_prepend(desktop->fixed_items, item);
-                item->fixed_pos = TRUE;
                 item->x = g_key_file_get_integer(kf, name, "x", NULL);
                 item->y = g_key_file_get_integer(kf, name, "y", NULL);
                 calc_item_size(desktop, item, icon);
+                fix_item_pos(desktop, item);
                 if(icon)
                     g_object_unref(icon);
             }
@@ -281,6 +501,17 @@ void load_items(FmDesktop* desktop)
     }
     g_free(path);
     g_key_file_free(kf);
+
+    /* the snapshot saved on exit is only good for the first listing */
+    if(!desktop->layout_snapshot_checked)
+    {
+        desktop->layout_snapshot_checked = TRUE;
+        if(apply_layout_snapshot(desktop))
+        {
+            queue_layout_revalidation(desktop);
+            return;
+        }
+    }
     queue_layout_items(desktop);
 }
 
@@ -289,6 +520,8 @@ void unload_items(FmDesktop* desktop)
     /* remove existing fixed items */
     g_list_free(desktop->fixed_items);
     desktop->fixed_items = NULL;
+    g_array_set_size(desktop->fixed_rects, 0);
+    g_ptr_array_set_size(desktop->fixed_rect_items, 0);
     desktop->focus = NULL;
     desktop->drop_hilight = NULL;
     desktop->hover_item = NULL;
@@ -429,341 +662,1822 @@ static void calculate_item_metrics(FmDesktop* self)
     self->text_w += 4; /* 4 is for drawing border */
     self->cell_h = app_config->desktop_icon_size + self->spacing + self->text_h + self->ypad * 2;
     self->cell_w = MAX((gint)self->text_w, app_config->desktop_icon_size) + self->xpad * 2;
+
+    spatial_grid_set_cell_size(self->items_index, self->cell_w, self->cell_h);
 }
 
-static inline void get_item_rect(FmDesktopItem* item, GdkRectangle* rect)
+/* tests the rect against the rects of all fixed items but exclude */
+static gboolean test_fixed_rects(FmDesktop* desktop, const GdkRectangle* rect, FmDesktopItem* exclude)
 {
-    gdk_rectangle_union(&item->icon_rect, &item->text_rect, rect);
+    guint n = desktop->fixed_rects->len;
+    guint32* hits;
+    guint i;
+
+    if(n == 0)
+        return FALSE;
+
+    g_array_set_size(desktop->fixed_rect_hits, RECT_BATCH_MASK_WORDS(n));
+    hits = (guint32*)desktop->fixed_rect_hits->data;
+    rect_batch_intersect((GdkRectangle*)desktop->fixed_rects->data, n, rect, hits);
+    for(i = 0; i < RECT_BATCH_MASK_WORDS(n); i++)
+    {
+        guint32 word = hits[i];
+        while(word)
+        {
+            if(g_ptr_array_index(desktop->fixed_rect_items, i * 32 + g_bit_nth_lsf(word, -1)) != exclude)
+                return TRUE;
+            word &= word - 1;
+        }
+    }
+    return FALSE;
 }
 
 static gboolean is_pos_occupied(FmDesktop* desktop, FmDesktopItem* item)
 {
-    GList* l;
-    for(l = desktop->fixed_items; l; l=l->next)
-    {
-        FmDesktopItem* fixed = (FmDesktopItem*)l->data;
-        GdkRectangle rect;
-        get_item_rect(fixed, &rect);
-        if(gdk_rectangle_intersect(&rect, &item->icon_rect, NULL)
-         ||gdk_rectangle_intersect(&rect, &item->text_rect, NULL))
-            return TRUE;
-    }
+    if(test_fixed_rects(desktop, &item->icon_rect, item)
+     ||test_fixed_rects(desktop, &item->text_rect, item))
+        return TRUE;
 
     return fm_window_tracker_test_overlap(&item->icon_rect) || fm_window_tracker_test_overlap(&item->text_rect);
 }
 
-static void layout_items(FmDesktop* self)
+static void redraw_item(FmDesktop* desktop, FmDesktopItem* item);
+
+/* Turns the item into a placeholder that takes no room, has no icon and
+   no label. It is measured again once it gets a cell on the screen. */
+static void set_item_virtual(FmDesktop* desktop, FmDesktopItem* item, int x, int y)
 {
-    FmDesktopItem* item;
-    GtkTreeModel* model = GTK_TREE_MODEL(self->model);
-    GdkPixbuf* icon;
-    GtkTreeIter it;
+    item->is_virtual = TRUE;
+    item->x = x;
+    item->y = y;
+    item->icon_rect.x = item->text_rect.x = x;
+    item->icon_rect.y = item->text_rect.y = y;
+    item->icon_rect.width = item->text_rect.width = 0;
+    item->icon_rect.height = item->text_rect.height = 0;
+    item->pango_timestamp = 0;
+    cached_layout_image_invalidate(&item->cached_text);
+    cached_layout_image_invalidate(&item->cached_text_shadow);
+    item_tile_invalidate(&item->tile);
+    update_item_index(desktop, item);
+}
 
-    calculate_item_metrics(self);
+/* move the item rects along with its position, without measuring it again */
+static void set_item_position(FmDesktop* desktop, FmDesktopItem* item, int x, int y)
+{
+    int dx = x - item->x;
+    int dy = y - item->y;
 
-    if(!gtk_tree_model_get_iter_first(model, &it))
-    {
-        gtk_widget_queue_draw(GTK_WIDGET(self));
-        return;
-    }
+    item->x = x;
+    item->y = y;
 
-    CellPlacementGenerator cpg;
-    cell_placement_generator_set_bounding_box(&cpg,
+    item->icon_rect.x += dx;
+    item->icon_rect.y += dy;
+    item->text_rect.x += dx;
+    item->text_rect.y += dy;
+
+    update_item_index(desktop, item);
+}
+
+static void init_cell_placement_generator(FmDesktop* self, CellPlacementGenerator* cpg)
+{
+    cell_placement_generator_set_bounding_box(cpg,
         self->working_area.x + self->xmargin,
         self->working_area.y + self->ymargin,
         self->working_area.x + self->working_area.width - self->xmargin,
         self->working_area.y + self->working_area.height - self->ymargin
     );
-    cell_placement_generator_set_cell_size(&cpg,
+    cell_placement_generator_set_cell_size(cpg,
         self->cell_w,
         self->cell_h
     );
-    cell_placement_generator_set_placement_rules(&cpg,
+    cell_placement_generator_set_placement_rules(cpg,
         app_config->arrange_icons_in_rows,
         app_config->arrange_icons_rtl,
         app_config->arrange_icons_btt
     );
+    cell_placement_generator_set_occupancy_map(cpg, NULL);
+}
 
-    cell_placement_generator_reset(&cpg);
+typedef struct
+{
+    CellPlacementGenerator* cpg;
+    int dx, dy; /* the point of a cell every item placed there covers */
+} occupancy_builder_t;
 
-    do
-    {
-        item = fm_folder_model_get_item_userdata(self->model, &it);
-        CONTINUE_IF_ITEM_IS_NULL(item);
+/* a cell is blocked once something covers the point, since is_pos_occupied()
+   would turn down any item placed there */
+static void mark_occupied_rect(GdkRectangle* rect, gpointer user_data)
+{
+    occupancy_builder_t* builder = (occupancy_builder_t*)user_data;
 
-        icon = NULL;
-        gtk_tree_model_get(model, &it, FM_FOLDER_MODEL_COL_ICON_WITH_THUMBNAIL, &icon, -1);
-        if (item->fixed_pos)
-        {
-            calc_item_size(self, item, icon);
-        }
-        else
-        {
-_next_position:
-            item->x = cpg.x;
-            item->y = cpg.y;
-            calc_item_size(self, item, icon);
+    cell_placement_generator_mark_occupied(builder->cpg, builder->dx, builder->dy,
+        rect->x,
+        rect->y,
+        rect->x + rect->width,
+        rect->y + rect->height
+    );
+}
 
-            cell_placement_generator_advance(&cpg);
+/* mark the cells covered by fixed items and by windows icons should not overlap,
+   so the generator can jump over them at once */
+static guint64* build_occupancy_map(FmDesktop* self, CellPlacementGenerator* cpg)
+{
+    guint64* map;
+    occupancy_builder_t builder;
+    GList* l;
 
-            /* check if this position is occupied by a fixed item */
-            if (is_pos_occupied(self, item))
-                goto _next_position;
-        }
-        if (icon)
-            g_object_unref(icon);
+    /* The middle pixel of the icon slot is in the icon rect of every
+       pixbuf calc_item_size() centers there. Without a pixbuf the icon
+       rect is not centered, so it is only known to cover the point as
+       long as the cell is not much wider than the icon. */
+    builder.cpg = cpg;
+    builder.dx = (self->cell_w - 1) / 2;
+    builder.dy = self->ypad + (app_config->desktop_icon_size - 1) / 2;
+    if(builder.dx < (int)self->ypad || builder.dx >= (int)self->ypad + app_config->desktop_icon_size)
+        return NULL;
+
+    map = g_new0(guint64, cell_placement_generator_get_occupancy_map_size(cpg));
+    cell_placement_generator_set_occupancy_map(cpg, map);
+
+    for(l = self->fixed_items; l; l = l->next)
+    {
+        GdkRectangle rect;
+        get_item_rect((FmDesktopItem*)l->data, &rect);
+        mark_occupied_rect(&rect, &builder);
     }
-    while(gtk_tree_model_iter_next(model, &it));
 
-    gtk_widget_queue_draw(GTK_WIDGET(self));
+    fm_window_tracker_foreach_overlap_rect(mark_occupied_rect, &builder);
+
+    return map;
 }
 
-static gboolean on_idle_layout(FmDesktop* desktop)
+static void queue_layout_items(FmDesktop* desktop);
+
+static void on_labels_measured(gpointer user_data)
 {
-    desktop->idle_layout = 0;
-    layout_items(desktop);
-    return FALSE;
+    FmDesktop* self = (FmDesktop*)user_data;
+    self->label_request = NULL;
+    queue_layout_items(self);
 }
 
-static void queue_layout_items(FmDesktop* desktop)
+/* Hands the labels that are neither measured for the current font nor cached
+   over to the worker pool. Returns TRUE if the layout has to wait for them. */
+static gboolean measure_labels_in_background(FmDesktop* self)
 {
-    if(0 == desktop->idle_layout)
-        desktop->idle_layout = g_idle_add((GSourceFunc)on_idle_layout, desktop);
+    GtkTreeModel* model = GTK_TREE_MODEL(self->model);
+    GtkTreeIter it;
+    GPtrArray* texts;
+    const char* font_key;
+
+    if(self->label_request)
+        return TRUE; /* the layout is queued again when it is done */
+
+    /* try only once per font, whatever does not fit into the cache is measured in place */
+    if(self->label_request_timestamp == self->pango_timestamp || !text_measure_pool_is_available())
+        return FALSE;
+    /* only what fits on the screen gets measured anyway */
+    if(app_config->hide_overflow_icons)
+        return FALSE;
+    self->label_request_timestamp = self->pango_timestamp;
+
+    if(!gtk_tree_model_get_iter_first(model, &it))
+        return FALSE;
+
+    pango_layout_set_height(self->pl, self->pango_text_h);
+    pango_layout_set_width(self->pl, self->pango_text_w);
+    font_key = get_text_font_key(self);
+
+    texts = g_ptr_array_new_with_free_func(g_free);
+    do
+    {
+        FmDesktopItem* item = fm_folder_model_get_item_userdata(self->model, &it);
+        const char* name;
+        PangoRectangle rc;
+        CONTINUE_IF_ITEM_IS_NULL(item);
+        if(item->pango_timestamp == self->pango_timestamp)
+            continue;
+        name = fm_file_info_get_disp_name(item->fi);
+        if(!name || text_extents_cache_lookup(name, font_key, self->pango_text_w, self->pango_text_h, &rc))
+            continue;
+        g_ptr_array_add(texts, g_strdup(name));
+    }
+    while(gtk_tree_model_iter_next(model, &it));
+
+    /* not worth a round trip through the pool */
+    if(texts->len < MIN_BACKGROUND_LABELS)
+    {
+        g_ptr_array_free(texts, TRUE);
+        return FALSE;
+    }
+
+    self->label_request = text_measure_request_new(self->pl, font_key, texts, on_labels_measured, self);
+    return TRUE;
 }
 
-static void paint_item_text(FmDesktop* self, FmDesktopItem* item, cached_layout_image_t * cache, float blur_radius, cairo_t* cr)
+/* find the cell the auto-placed items starting from the given row continue from */
+static long get_first_free_cell_index(FmDesktop* self, gint row)
 {
-    cairo_save(cr);
-
-//g_print("%d, %d\n", item->text_pango_logical_rect.x, item->text_pango_logical_rect.y);
+    GtkTreeModel* model = GTK_TREE_MODEL(self->model);
+    GtkTreeIter it;
 
-    if (!cached_layout_image_check_timestamp(cache, self->pango_timestamp))
+    while(--row >= 0)
     {
-        cache->timestamp = self->pango_timestamp;
-        g_debug("creating cached surface %dx%d", item->text_rect.width, item->text_rect.height);
-        cache->surface = cairo_surface_create_similar(cairo_get_target(cr),
-            //CAIRO_CONTENT_COLOR_ALPHA,
-            CAIRO_CONTENT_ALPHA,
-            item->text_rect.width + item->text_pango_logical_rect.x,
-            item->text_rect.height + item->text_pango_logical_rect.y);
-
-        cairo_t * cr2 = cairo_create(cache->surface);
-        cairo_set_source_rgb(cr2, 1, 1, 1);
-        cairo_move_to(cr2, 0, 0);
-        pango_cairo_update_layout(cr2, self->pl);
-        pango_cairo_show_layout(cr2, self->pl);
+        FmDesktopItem* item;
+        if(!gtk_tree_model_iter_nth_child(model, &it, NULL, row))
+            break;
+        item = fm_folder_model_get_item_userdata(self->model, &it);
+        if(item && !item->fixed_pos)
+            return item->cell_index < 0 ? -1 : item->cell_index + 1;
+    }
 
-        cairo_destroy(cr2);
+    return 0;
+}
 
-        if (blur_radius > 0)
-        {
-            cairo_surface_t * surface = cairo_surface_create_similar(cairo_get_target(cr),
-                //CAIRO_CONTENT_COLOR_ALPHA,
-                CAIRO_CONTENT_ALPHA,
-                item->text_rect.width + item->text_pango_logical_rect.x,
-                item->text_rect.height + item->text_pango_logical_rect.y);
+/* A layout pass lays out items starting from the given row.
+   A full pass measures and places every item and redraws the whole desktop.
+   A partial one expects the items before start_row to be in place: it only
+   measures new items, shifts the others to their new cells and redraws the
+   items that have actually moved.
+   A pass can be run in several time slices; it only keeps the number of the
+   next row between them, so the model may change in the meantime. */
+struct _FmDesktopLayoutPass
+{
+    gint start_row;
+    gint row; /* the next row to lay out */
+    long start_cell;
+    gboolean full;
+    gboolean placing; /* a full pass measures fixed items before placing the others */
+    CellPlacementGenerator cpg;
+    guint64* occupancy;
+};
 
-            cairo_t * cr3 = cairo_create(surface);
-            cairo_set_source_rgba(cr3, 1, 1, 1, 0.3);
+/* check the clock after this many items */
+#define LAYOUT_CLOCK_INTERVAL 16
 
-            float r = blur_radius;
+static void layout_pass_free(FmDesktopLayoutPass* pass)
+{
+    g_free(pass->occupancy);
+    g_slice_free(FmDesktopLayoutPass, pass);
+}
 
-            cairo_mask_surface(cr3, cache->surface, 0, 0);
-            cairo_fill(cr3);
+static void layout_pass_begin_placement(FmDesktop* self, FmDesktopLayoutPass* pass)
+{
+    init_cell_placement_generator(self, &pass->cpg);
+    pass->occupancy = build_occupancy_map(self, &pass->cpg);
+    cell_placement_generator_seek(&pass->cpg, pass->start_cell);
+    pass->row = pass->start_row;
+    pass->placing = TRUE;
+}
 
-            cairo_mask_surface(cr3, cache->surface, 0, r);
-            cairo_fill(cr3);
+/* Returns NULL if there is nothing to lay out right now. A full pass may
+   wait for the labels to be measured in background, unless it is run at
+   once, in which case it measures them in place. */
+static FmDesktopLayoutPass* layout_pass_new(FmDesktop* self, gint start_row, gboolean full, gboolean at_once)
+{
+    GtkTreeModel* model = GTK_TREE_MODEL(self->model);
+    GtkTreeIter it;
+    FmDesktopLayoutPass* pass;
+    long start_cell = 0;
 
-            cairo_mask_surface(cr3, cache->surface, 0, -r);
-            cairo_fill(cr3);
+    if(!full)
+    {
+        guint old_cell_w = self->cell_w;
+        guint old_cell_h = self->cell_h;
+        guint old_text_w = self->text_w;
+        guint old_text_h = self->text_h;
+        calculate_item_metrics(self);
+        if(old_cell_w != self->cell_w || old_cell_h != self->cell_h
+        || old_text_w != self->text_w || old_text_h != self->text_h)
+            full = TRUE;
+    }
+    else
+        calculate_item_metrics(self);
 
-            cairo_mask_surface(cr3, cache->surface, r, 0);
-            cairo_fill(cr3);
+    if(full)
+    {
+        start_row = 0;
+        if(!at_once && measure_labels_in_background(self))
+            return NULL;
+    }
+    else
+    {
+        start_cell = get_first_free_cell_index(self, start_row);
+        if(start_cell < 0) /* the previous items were never placed */
+        {
+            full = TRUE;
+            start_row = 0;
+            start_cell = 0;
+        }
+    }
 
-            cairo_mask_surface(cr3, cache->surface, -r, 0);
-            cairo_fill(cr3);
+    if(!gtk_tree_model_iter_nth_child(model, &it, NULL, start_row))
+    {
+        if(full)
+            queue_draw_items(self);
+        return NULL;
+    }
 
-            float c45 = 0.7 * r;
+    pass = g_slice_new0(FmDesktopLayoutPass);
+    pass->start_row = start_row;
+    pass->start_cell = start_cell;
+    pass->full = full;
+    if(full)
+        pass->row = 0;
+    else
+        layout_pass_begin_placement(self, pass);
+    return pass;
+}
 
-            cairo_mask_surface(cr3, cache->surface, c45, c45);
-            cairo_fill(cr3);
+static void measure_fixed_item(FmDesktop* self, GtkTreeIter* it)
+{
+    FmDesktopItem* item = fm_folder_model_get_item_userdata(self->model, it);
+    GdkPixbuf* icon = NULL;
 
-            cairo_mask_surface(cr3, cache->surface, c45, -c45);
-            cairo_fill(cr3);
+    if(!item || !item->fixed_pos)
+        return;
+
+    gtk_tree_model_get(GTK_TREE_MODEL(self->model), it, FM_FOLDER_MODEL_COL_ICON_WITH_THUMBNAIL, &icon, -1);
+    calc_item_size(self, item, icon);
+    update_fixed_item_index(self, item);
+    if (icon)
+        g_object_unref(icon);
+}
+
+static void layout_item(FmDesktop* self, FmDesktopLayoutPass* pass, GtkTreeIter* it)
+{
+    GtkTreeModel* model = GTK_TREE_MODEL(self->model);
+    CellPlacementGenerator* cpg = &pass->cpg;
+    FmDesktopItem* item = fm_folder_model_get_item_userdata(self->model, it);
+    GdkPixbuf* icon = NULL;
+    GdkRectangle old_rect;
+
+    if(!item)
+    {
+        g_debug("item is NULL");
+        return;
+    }
+
+    item->z = pass->row;
+
+    /* an item that is not measured yet is placed the same way as in a full layout */
+    gboolean measured = !pass->full && item->pango_timestamp == self->pango_timestamp;
+    gboolean placed = measured && (item->fixed_pos || item->cell_index >= 0);
+
+    if(item->fixed_pos && (placed || pass->full))
+        return;
+
+    if(placed)
+        get_item_rect(item, &old_rect);
+
+    if (item->fixed_pos)
+    {
+        if(!measured)
+            gtk_tree_model_get(model, it, FM_FOLDER_MODEL_COL_ICON_WITH_THUMBNAIL, &icon, -1);
+        calc_item_size(self, item, icon);
+        update_fixed_item_index(self, item);
+    }
+    else
+    {
+_next_position:
+        cell_placement_generator_skip_occupied(cpg);
+        if(app_config->hide_overflow_icons && cpg->tier > 0)
+        {
+            /* no room left on the screen, so are the rest of the items */
+            set_item_virtual(self, item, cpg->x, cpg->y);
+            item->cell_index = cpg->index;
+        }
+        else
+        {
+            if(measured)
+                set_item_position(self, item, cpg->x, cpg->y);
+            else
+            {
+                if(!icon)
+                    gtk_tree_model_get(model, it, FM_FOLDER_MODEL_COL_ICON_WITH_THUMBNAIL, &icon, -1);
+                item->x = cpg->x;
+                item->y = cpg->y;
+                calc_item_size(self, item, icon);
+            }
+            item->cell_index = cpg->index;
+
+            cell_placement_generator_advance(cpg);
+
+            /* the map is coarse, check the actual rects */
+            if (is_pos_occupied(self, item))
+                goto _next_position;
+        }
+    }
+    if (icon)
+        g_object_unref(icon);
+
+    if(!pass->full)
+    {
+        GdkRectangle new_rect;
+        get_item_rect(item, &new_rect);
+        if(!placed)
+            redraw_item(self, item);
+        else if(old_rect.x != new_rect.x || old_rect.y != new_rect.y
+             || old_rect.width != new_rect.width || old_rect.height != new_rect.height)
+        {
+            FmDesktopItem old_item = *item;
+            old_item.icon_rect = old_rect;
+            old_item.text_rect = old_rect;
+            redraw_item(self, &old_item);
+            redraw_item(self, item);
+        }
+    }
+}
+
+/* Runs the pass until it is done or the deadline (in g_get_monotonic_time()
+   units) has passed. Returns TRUE once the pass is complete. */
+static gboolean layout_pass_run(FmDesktop* self, FmDesktopLayoutPass* pass, gint64 deadline)
+{
+    GtkTreeModel* model = GTK_TREE_MODEL(self->model);
+    GtkTreeIter it;
+    gboolean more;
+    guint n = 0;
+
+    if(!pass->placing)
+    {
+        /* measure fixed items first, so the occupancy map sees their current rects */
+        more = gtk_tree_model_iter_nth_child(model, &it, NULL, pass->row);
+        while(more)
+        {
+            measure_fixed_item(self, &it);
+            pass->row++;
+            more = gtk_tree_model_iter_next(model, &it);
+            if(more && ++n % LAYOUT_CLOCK_INTERVAL == 0 && g_get_monotonic_time() >= deadline)
+                return FALSE;
+        }
+        layout_pass_begin_placement(self, pass);
+    }
+
+    more = gtk_tree_model_iter_nth_child(model, &it, NULL, pass->row);
+    while(more)
+    {
+        layout_item(self, pass, &it);
+        pass->row++;
+        more = gtk_tree_model_iter_next(model, &it);
+        if(more && ++n % LAYOUT_CLOCK_INTERVAL == 0 && g_get_monotonic_time() >= deadline)
+        {
+            /* show what is placed so far */
+            if(pass->full)
+                queue_draw_items(self);
+            return FALSE;
+        }
+    }
+
+    if(pass->full)
+        queue_draw_items(self);
+    queue_warm_up_labels(self);
+    return TRUE;
+}
+
+static void cancel_layout(FmDesktop* desktop)
+{
+    if(desktop->layout_pass)
+    {
+        layout_pass_free(desktop->layout_pass);
+        desktop->layout_pass = NULL;
+    }
+    if(desktop->idle_layout)
+    {
+        g_source_remove(desktop->idle_layout);
+        desktop->idle_layout = 0;
+    }
+    desktop->layout_full = FALSE;
+    desktop->layout_start_row = G_MAXINT;
+}
+
+/* lays out all items before returning, for the callers that need their positions */
+static void layout_items(FmDesktop* self)
+{
+    FmDesktopLayoutPass* pass;
+
+    /* whatever is in progress or queued is superseded */
+    cancel_layout(self);
+    if(self->label_request)
+    {
+        /* not waited for, the labels are measured in place */
+        text_measure_request_cancel(self->label_request);
+        self->label_request = NULL;
+    }
+
+    pass = layout_pass_new(self, 0, TRUE, TRUE);
+    if(pass)
+    {
+        layout_pass_run(self, pass, G_MAXINT64);
+        layout_pass_free(pass);
+    }
+}
+
+static gboolean on_idle_layout(FmDesktop* desktop)
+{
+    FmDesktopLayoutPass* pass = desktop->layout_pass;
+
+    if(desktop->layout_full || desktop->layout_start_row != G_MAXINT)
+    {
+        gboolean full = desktop->layout_full;
+        gint start_row = desktop->layout_start_row;
+
+        desktop->layout_full = FALSE;
+        desktop->layout_start_row = G_MAXINT;
+
+        /* A partial request for rows the pass in progress has not reached yet
+           is covered by it. That holds for a full pass that is still measuring
+           the fixed items too, as it places every row afterwards; but rows it
+           has measured already are not visited again until the placement,
+           which skips the fixed ones. */
+        if(!pass || full || start_row < pass->row)
+        {
+            if(pass)
+            {
+                /* superseded, start over from where either of them wanted */
+                full = full || pass->full;
+                start_row = MIN(start_row, pass->start_row);
+                layout_pass_free(pass);
+            }
+            pass = desktop->layout_pass = layout_pass_new(desktop, start_row, full, FALSE);
+        }
+    }
+
+    if(pass)
+    {
+        gint64 deadline = G_MAXINT64;
+        if(app_config->layout_time_slice > 0)
+            deadline = g_get_monotonic_time() + (gint64)app_config->layout_time_slice * 1000;
+        if(!layout_pass_run(desktop, pass, deadline))
+            return TRUE; /* continue in the next slice */
+        layout_pass_free(pass);
+        desktop->layout_pass = NULL;
+    }
+
+    desktop->idle_layout = 0;
+    return FALSE;
+}
+
+static void queue_layout_items(FmDesktop* desktop)
+{
+    desktop->layout_full = TRUE;
+    if(0 == desktop->idle_layout)
+        desktop->idle_layout = g_idle_add((GSourceFunc)on_idle_layout, desktop);
+}
+
+/* relayout only the items from the given row to the end */
+static void queue_layout_items_from(FmDesktop* desktop, gint row)
+{
+    desktop->layout_start_row = MIN(desktop->layout_start_row, row);
+    if(0 == desktop->idle_layout)
+        desktop->idle_layout = g_idle_add((GSourceFunc)on_idle_layout, desktop);
+}
+
+/****************************************************************************/
+
+/* Layout snapshot: the computed layout is saved on exit and applied as is
+   on the next start, if nothing it depends on has changed. The fixed
+   positions still come from desktop-items-*.conf. */
+
+#define LAYOUT_SNAPSHOT_VERSION 2
+
+/* x, y, cell index, text logical rect, is virtual */
+#define LAYOUT_SNAPSHOT_FIELDS 8
+
+static char* get_layout_snapshot_file(FmDesktop* desktop, gboolean create_dir)
+{
+    int screen_n = gdk_screen_get_number(gtk_widget_get_screen(GTK_WIDGET(desktop)));
+
+    gchar * dir = pcmanfm_get_profile_dir(create_dir);
+    gchar * path = g_strdup_printf("%s/desktop-layout-%u-%u.cache", dir, screen_n, desktop->monitor);
+
+    g_free(dir);
+
+    return path;
+}
+
+/* everything the layout depends on besides the folder listing */
+static char* get_layout_fingerprint(FmDesktop* self)
+{
+    return g_strdup_printf("%d|%s|%d|%d,%d,%d,%d|%d,%d,%d,%d|%u,%u,%u,%u",
+        LAYOUT_SNAPSHOT_VERSION,
+        get_text_font_key(self),
+        app_config->desktop_icon_size,
+        self->working_area.x, self->working_area.y,
+        self->working_area.width, self->working_area.height,
+        app_config->arrange_icons_in_rows ? 1 : 0,
+        app_config->arrange_icons_rtl ? 1 : 0,
+        app_config->arrange_icons_btt ? 1 : 0,
+        app_config->hide_overflow_icons ? 1 : 0,
+        self->cell_w, self->cell_h, self->pango_text_w, self->pango_text_h);
+}
+
+static void save_layout_snapshot(FmDesktop* self)
+{
+    GtkTreeModel* model = GTK_TREE_MODEL(self->model);
+    GtkTreeIter it;
+    GPtrArray* names;
+    GArray* geometry;
+    GKeyFile* kf;
+    gboolean settled = TRUE;
+    char* path;
+
+    /* a layout still in progress is not worth saving */
+    if(self->idle_layout || self->label_request)
+        return;
+    if(!gtk_tree_model_get_iter_first(model, &it))
+        return;
+
+    names = g_ptr_array_new();
+    geometry = g_array_new(FALSE, FALSE, sizeof(gint));
+    do
+    {
+        FmDesktopItem* item = fm_folder_model_get_item_userdata(self->model, &it);
+        gint g[LAYOUT_SNAPSHOT_FIELDS];
+        CONTINUE_IF_ITEM_IS_NULL(item);
+        if((item->pango_timestamp != self->pango_timestamp && !item->is_virtual)
+         || (!item->fixed_pos && item->cell_index < 0))
+        {
+            settled = FALSE;
+            break;
+        }
+        g[0] = item->x;
+        g[1] = item->y;
+        g[2] = item->cell_index;
+        g[3] = item->text_pango_logical_rect.x;
+        g[4] = item->text_pango_logical_rect.y;
+        g[5] = item->text_pango_logical_rect.width;
+        g[6] = item->text_pango_logical_rect.height;
+        g[7] = item->is_virtual;
+        g_ptr_array_add(names, (gpointer)fm_file_info_get_name(item->fi));
+        g_array_append_vals(geometry, g, LAYOUT_SNAPSHOT_FIELDS);
+    }
+    while(gtk_tree_model_iter_next(model, &it));
+
+    if(settled && names->len > 0)
+    {
+        char* fingerprint = get_layout_fingerprint(self);
+        char* data;
+        gsize len;
+
+        kf = g_key_file_new();
+        g_key_file_set_string(kf, "Layout", "Fingerprint", fingerprint);
+        g_key_file_set_string_list(kf, "Layout", "Names", (const gchar* const*)names->pdata, names->len);
+        g_key_file_set_integer_list(kf, "Layout", "Geometry", (gint*)geometry->data, geometry->len);
+        data = g_key_file_to_data(kf, &len, NULL);
+
+        path = get_layout_snapshot_file(self, TRUE);
+        g_file_set_contents(path, data, len, NULL);
+
+        g_free(path);
+        g_free(data);
+        g_free(fingerprint);
+        g_key_file_free(kf);
+    }
+
+    g_ptr_array_free(names, TRUE);
+    g_array_free(geometry, TRUE);
+}
+
+/* Puts the items where the snapshot says, if it was made with the same
+   settings and for the same folder listing. Labels are not measured,
+   the saved extents are put into the text extents cache instead. */
+static gboolean apply_layout_snapshot(FmDesktop* self)
+{
+    GtkTreeModel* model = GTK_TREE_MODEL(self->model);
+    GtkTreeIter it;
+    GKeyFile* kf;
+    char* path;
+    char* fingerprint;
+    char* saved_fingerprint;
+    gchar** names = NULL;
+    gint* geometry = NULL;
+    gsize n_names = 0, n_geometry = 0, i;
+    const char* font_key;
+    gboolean ok = FALSE;
+
+    if(!gtk_tree_model_get_iter_first(model, &it))
+        return FALSE;
+
+    path = get_layout_snapshot_file(self, FALSE);
+    kf = g_key_file_new();
+    if(!g_key_file_load_from_file(kf, path, 0, NULL))
+        goto _out;
+
+    calculate_item_metrics(self);
+    fingerprint = get_layout_fingerprint(self);
+    saved_fingerprint = g_key_file_get_string(kf, "Layout", "Fingerprint", NULL);
+    ok = g_strcmp0(fingerprint, saved_fingerprint) == 0;
+    g_free(fingerprint);
+    g_free(saved_fingerprint);
+    if(!ok)
+        goto _out;
+
+    names = g_key_file_get_string_list(kf, "Layout", "Names", &n_names, NULL);
+    geometry = g_key_file_get_integer_list(kf, "Layout", "Geometry", &n_geometry, NULL);
+    ok = names && geometry && n_geometry == n_names * LAYOUT_SNAPSHOT_FIELDS;
+
+    /* the listing has to match item by item */
+    i = 0;
+    if(ok) do
+    {
+        FmDesktopItem* item = fm_folder_model_get_item_userdata(self->model, &it);
+        CONTINUE_IF_ITEM_IS_NULL(item);
+        if(i >= n_names || strcmp(names[i], fm_file_info_get_name(item->fi)) != 0)
+        {
+            ok = FALSE;
+            break;
+        }
+        i++;
+    }
+    while(gtk_tree_model_iter_next(model, &it));
+    ok = ok && i == n_names;
+    if(!ok)
+        goto _out;
+
+    font_key = get_text_font_key(self);
+    gtk_tree_model_get_iter_first(model, &it);
+    i = 0;
+    do
+    {
+        FmDesktopItem* item = fm_folder_model_get_item_userdata(self->model, &it);
+        const gint* g;
+        GdkPixbuf* icon = NULL;
+        CONTINUE_IF_ITEM_IS_NULL(item);
+        g = geometry + i * LAYOUT_SNAPSHOT_FIELDS;
+        item->z = i;
+        i++;
+
+        if(g[7] && !item->fixed_pos)
+        {
+            set_item_virtual(self, item, g[0], g[1]);
+            item->cell_index = g[2];
+            continue;
+        }
+
+        item->text_pango_logical_rect.x = g[3];
+        item->text_pango_logical_rect.y = g[4];
+        item->text_pango_logical_rect.width = g[5];
+        item->text_pango_logical_rect.height = g[6];
+        item->pango_timestamp = self->pango_timestamp;
+        cached_layout_image_invalidate(&item->cached_text);
+        cached_layout_image_invalidate(&item->cached_text_shadow);
+        item_tile_invalidate(&item->tile);
+        text_extents_cache_insert(fm_file_info_get_disp_name(item->fi), font_key,
+            self->pango_text_w, self->pango_text_h, &item->text_pango_logical_rect);
+
+        if(!item->fixed_pos)
+        {
+            item->x = g[0];
+            item->y = g[1];
+            item->cell_index = g[2];
+        }
+
+        gtk_tree_model_get(model, &it, FM_FOLDER_MODEL_COL_ICON_WITH_THUMBNAIL, &icon, -1);
+        calc_item_size(self, item, icon);
+        if(item->fixed_pos)
+            update_fixed_item_index(self, item);
+        if(icon)
+            g_object_unref(icon);
+    }
+    while(gtk_tree_model_iter_next(model, &it));
+
+    queue_draw_items(self);
+    queue_warm_up_labels(self);
+
+_out:
+    g_strfreev(names);
+    g_free(geometry);
+    g_free(path);
+    g_key_file_free(kf);
+    return ok;
+}
+
+/* check the applied snapshot with a full layout once nothing else is pending */
+static void queue_layout_revalidation(FmDesktop* desktop)
+{
+    desktop->layout_full = TRUE;
+    if(0 == desktop->idle_layout)
+        desktop->idle_layout = g_idle_add_full(G_PRIORITY_LOW, (GSourceFunc)on_idle_layout, desktop, NULL);
+}
+
+typedef struct _shadow_style
+{
+    double offset;
+    double sigma; /* 0 for no blur */
+    double gain;
+} shadow_style_t;
+
+/* indexed by FmShadowStyle */
+static const shadow_style_t shadow_styles[] =
+{
+    { 1.0, 0.0,  1.0 }, /* Thin */
+    { 1.0, 0.45, 1.6 }, /* Normal */
+    { 1.3, 1.0,  2.2 }, /* Bold */
+    { 1.5, 1.3,  2.6 }  /* Bold 2 */
+};
+
+static BlurKernel* shadow_kernels[G_N_ELEMENTS(shadow_styles)];
+
+static const BlurKernel* get_shadow_kernel(guint i)
+{
+    if (shadow_styles[i].sigma > 0 && !shadow_kernels[i])
+        shadow_kernels[i] = blur_kernel_new(shadow_styles[i].sigma, shadow_styles[i].gain);
+    return shadow_kernels[i];
+}
+
+static const shadow_style_t* get_shadow_style(const BlurKernel** kernel)
+{
+    guint i = CLAMP((int)app_config->desktop_shadow_style, 0, (int)G_N_ELEMENTS(shadow_styles) - 1);
+
+    *kernel = get_shadow_kernel(i);
+    return &shadow_styles[i];
+}
+
+/* Room around the item rects for the focus rect and for the shadow of
+   every preset, so the painted area does not change with the preset. */
+static int get_item_tile_margin(void)
+{
+    static int margin = 0;
+    guint i;
+
+    if (margin)
+        return margin;
+
+    margin = 2; /* the focus rect */
+    for (i = 0; i < G_N_ELEMENTS(shadow_styles); i++)
+    {
+        const BlurKernel* kernel = get_shadow_kernel(i);
+        int reach = (int) ceil(shadow_styles[i].offset) + (kernel ? blur_kernel_get_radius(kernel) : 0);
+        margin = MAX(margin, reach);
+    }
+    return margin;
+}
+
+/* The label masks and the item tiles of all desktops share one memory
+   budget. The masks get half of it at most, the tiles what is left.
+   The icon layers are not in it: each desktop needs its layer whole.
+
+   The pages of an atlas are created similar to the windows of the desktop
+   that needed them first, so every screen gets an atlas of its own, and
+   the atlases split the half of the masks between them. */
+typedef struct _label_atlas_slot
+{
+    GdkScreen* screen;
+    LabelAtlas* atlas; /* created when the first mask is rendered */
+    guint users;
+} label_atlas_slot_t;
+
+static GSList* label_atlases = NULL; /* label_atlas_slot_t, for the screens that have desktops */
+
+static inline gsize get_label_cache_budget(void)
+{
+    return (gsize) MAX(app_config->label_cache_size, 1) << 20;
+}
+
+static void update_label_atlas_budgets(void)
+{
+    gsize budget = get_label_cache_budget() / 2 / MAX(g_slist_length(label_atlases), 1);
+    GSList* l;
+
+    for (l = label_atlases; l; l = l->next)
+    {
+        label_atlas_slot_t* slot = (label_atlas_slot_t*) l->data;
+        if (slot->atlas)
+            label_atlas_set_budget(slot->atlas, budget);
+    }
+}
+
+static label_atlas_slot_t* find_label_atlas_slot(GdkScreen* screen)
+{
+    GSList* l;
+    for (l = label_atlases; l; l = l->next)
+        if (((label_atlas_slot_t*) l->data)->screen == screen)
+            return (label_atlas_slot_t*) l->data;
+    return NULL;
+}
+
+static void ref_label_atlas(GdkScreen* screen)
+{
+    label_atlas_slot_t* slot = find_label_atlas_slot(screen);
+
+    if (!slot)
+    {
+        slot = g_slice_new0(label_atlas_slot_t);
+        slot->screen = screen;
+        label_atlases = g_slist_prepend(label_atlases, slot);
+        update_label_atlas_budgets();
+    }
+    slot->users++;
+}
+
+static void unref_label_atlas(GdkScreen* screen)
+{
+    label_atlas_slot_t* slot = find_label_atlas_slot(screen);
+
+    if (!slot || --slot->users > 0)
+        return;
+    label_atlases = g_slist_remove(label_atlases, slot);
+    label_atlas_free(slot->atlas);
+    g_slice_free(label_atlas_slot_t, slot);
+    update_label_atlas_budgets();
+}
+
+/* the atlases of all screens together */
+static void get_label_atlas_stats(LabelAtlasStats* stats)
+{
+    static const LabelAtlasStats zero = {0};
+    GSList* l;
+
+    *stats = zero;
+    for (l = label_atlases; l; l = l->next)
+    {
+        label_atlas_slot_t* slot = (label_atlas_slot_t*) l->data;
+        LabelAtlasStats s;
+        if (!slot->atlas)
+            continue;
+        label_atlas_get_stats(slot->atlas, &s);
+        stats->hits += s.hits;
+        stats->misses += s.misses;
+        stats->evictions += s.evictions;
+        stats->bytes += s.bytes;
+        stats->budget += s.budget;
+    }
+}
+
+static void log_label_cache_stats(void)
+{
+    LabelAtlasStats stats;
+
+    get_label_atlas_stats(&stats);
+    g_debug("label cache: masks %lu of %lu KiB used, %" G_GUINT64_FORMAT " hits, %" G_GUINT64_FORMAT
+            " misses, %" G_GUINT64_FORMAT " evictions",
+            (gulong) (stats.bytes >> 10), (gulong) (stats.budget >> 10),
+            stats.hits, stats.misses, stats.evictions);
+    stats = item_tile_stats;
+    g_debug("label cache: tiles %lu of %lu KiB used, %" G_GUINT64_FORMAT " hits, %" G_GUINT64_FORMAT
+            " misses, %" G_GUINT64_FORMAT " evictions",
+            (gulong) (stats.bytes >> 10), (gulong) (stats.budget >> 10),
+            stats.hits, stats.misses, stats.evictions);
+}
+
+/* Evicts the least recently painted tiles until room more bytes fit in
+   what the label masks leave of the budget. Returns FALSE if they do not
+   fit even then. */
+static gboolean trim_item_tiles(gsize room)
+{
+    gsize budget = get_label_cache_budget();
+    LabelAtlasStats stats;
+
+    get_label_atlas_stats(&stats);
+    budget -= MIN(stats.bytes, budget);
+    item_tile_stats.budget = budget;
+
+    while (item_tile_stats.bytes + room > budget && item_tiles.tail)
+    {
+        item_tile_invalidate((item_tile_t *) item_tiles.tail->data);
+        item_tile_stats.evictions++;
+    }
+    return item_tile_stats.bytes + room <= budget;
+}
+
+static void on_label_cache_size_changed(FmConfig* cfg, FmDesktop* desktop)
+{
+    /* the caches are shared, so the first desktop to get here does it for all */
+    update_label_atlas_budgets();
+    trim_item_tiles(0);
+}
+
+static LabelAtlasEntry* alloc_label_mask(FmDesktop* self, cairo_surface_t* target, int width, int height, LabelAtlasEntry** owner)
+{
+    label_atlas_slot_t* slot = find_label_atlas_slot(gtk_widget_get_screen((GtkWidget*)self));
+    LabelAtlasStats stats;
+    gsize bytes;
+    LabelAtlasEntry* entry;
+
+    if (!slot->atlas)
+        slot->atlas = label_atlas_new(LABEL_ATLAS_PAGE_SIZE,
+                                      get_label_cache_budget() / 2 / g_slist_length(label_atlases));
+
+    label_atlas_get_stats(slot->atlas, &stats);
+    bytes = stats.bytes;
+    entry = label_atlas_alloc(slot->atlas, target, width, height, owner);
+    label_atlas_get_stats(slot->atlas, &stats);
+    if (stats.bytes > bytes) /* a new page, make room for it */
+        trim_item_tiles(0);
+    return entry;
+}
+
+/* Sets up self->pl for the label of the item. */
+static void set_item_layout_text(FmDesktop* self, FmDesktopItem* item)
+{
+    pango_layout_set_text(self->pl, NULL, 0);
+    pango_layout_set_width(self->pl, self->pango_text_w);
+    pango_layout_set_height(self->pl, self->pango_text_h);
+
+    pango_layout_set_text(self->pl, fm_file_info_get_disp_name(item->fi), -1);
+}
+
+/* Checks if any label mask the item is painted with has to be rendered,
+   which is the only time self->pl is needed for it. */
+static gboolean item_labels_need_rendering(FmDesktop* self, FmDesktopItem* item, gboolean shadow)
+{
+    if (!cached_layout_image_check_timestamp(&item->cached_text, self->pango_timestamp))
+        return TRUE;
+    return shadow && !cached_layout_image_check_timestamp(&item->cached_text_shadow, self->pango_timestamp);
+}
+
+/* Renders the label mask into the atlas, unless it is there already.
+   self->pl has to be set up for the item. Returns FALSE on failure. */
+static gboolean render_item_text(FmDesktop* self, FmDesktopItem* item, cached_layout_image_t * cache, const BlurKernel* blur, cairo_surface_t* target)
+{
+    if (!cached_layout_image_check_timestamp(cache, self->pango_timestamp))
+    {
+        int width = item->text_rect.width + item->text_pango_logical_rect.x;
+        int height = item->text_rect.height + item->text_pango_logical_rect.y;
+
+        cache->timestamp = self->pango_timestamp;
+        cache->pad = blur ? blur_kernel_get_radius(blur) : 0;
+        width += cache->pad * 2;
+        height += cache->pad * 2;
+        if (!alloc_label_mask(self, target, width, height, &cache->entry))
+            return FALSE;
+
+        cairo_t * cr2 = label_atlas_entry_begin(cache->entry);
+        if (blur)
+        {
+            /* the blur works on the pixels, so it needs an image surface */
+            cairo_surface_t * surface = cairo_image_surface_create(CAIRO_FORMAT_A8, width, height);
+            cairo_t * cr3 = cairo_create(surface);
+            cairo_move_to(cr3, cache->pad, cache->pad);
+            pango_cairo_update_layout(cr3, self->pl);
+            pango_cairo_show_layout(cr3, self->pl);
+            cairo_destroy(cr3);
+
+            if (cairo_surface_status(surface) == CAIRO_STATUS_SUCCESS)
+            {
+                cairo_surface_flush(surface);
+                blur_a8(cairo_image_surface_get_data(surface), width, height,
+                        cairo_image_surface_get_stride(surface), blur);
+                cairo_surface_mark_dirty(surface);
+            }
+            cairo_set_source_surface(cr2, surface, 0, 0);
+            cairo_paint(cr2);
+            cairo_surface_destroy(surface);
+        }
+        else
+        {
+            cairo_set_source_rgb(cr2, 1, 1, 1);
+            cairo_move_to(cr2, 0, 0);
+            pango_cairo_update_layout(cr2, self->pl);
+            pango_cairo_show_layout(cr2, self->pl);
+        }
+        cairo_destroy(cr2);
+    }
+    return TRUE;
+}
+
+static void paint_item_text(FmDesktop* self, FmDesktopItem* item, cached_layout_image_t * cache, const BlurKernel* blur, cairo_t* cr)
+{
+    if (!render_item_text(self, item, cache, blur, cairo_get_target(cr)))
+        return;
+
+    cairo_save(cr);
+
+    double x, y;
+    cairo_get_current_point(cr, &x, &y);
+    label_atlas_entry_mask(cache->entry, cr, x - cache->pad, y - cache->pad);
+
+    cairo_restore(cr);
+}
+
+
+/* Icon variants kept in the icon surface cache. */
+#define ICON_VARIANT_SELECTED    (1 << 0)
+#define ICON_VARIANT_LINK        (1 << 1)
+
+/* Renders the icon the way the cell renderer draws it into a width x height
+   cell in the state. */
+static cairo_surface_t* render_icon_variant(FmDesktop* self, FmDesktopItem* item, GdkPixbuf* icon,
+                                            GtkCellRendererState state, int width, int height)
+{
+    GtkWidget* widget = (GtkWidget*)self;
+    GdkRectangle rect = {0, 0, width, height};
+    cairo_surface_t* surface;
+    cairo_t* cr;
+#if !GTK_CHECK_VERSION(3, 0, 0)
+    GdkColormap* colormap;
+    GdkPixmap* pixmap;
+    cairo_t* pixmap_cr;
+
+    /* the cell renderer needs a drawable, so render to an ARGB pixmap first */
+    colormap = gdk_screen_get_rgba_colormap(gtk_widget_get_screen(widget));
+    if (!colormap)
+        return NULL;
+#endif
+
+    surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, rect.width, rect.height);
+    if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS)
+    {
+        cairo_surface_destroy(surface);
+        return NULL;
+    }
+    cr = cairo_create(surface);
+
+    g_object_set(self->icon_render, "pixbuf", icon, "info", item->fi, NULL);
+#if GTK_CHECK_VERSION(3, 0, 0)
+    gtk_cell_renderer_render(GTK_CELL_RENDERER(self->icon_render), cr, widget, &rect, &rect, state);
+#else
+    pixmap = gdk_pixmap_new(gtk_widget_get_window(widget), rect.width, rect.height,
+                            gdk_colormap_get_visual(colormap)->depth);
+    gdk_drawable_set_colormap(pixmap, colormap);
+    pixmap_cr = gdk_cairo_create(pixmap);
+    cairo_set_operator(pixmap_cr, CAIRO_OPERATOR_CLEAR);
+    cairo_paint(pixmap_cr);
+    gtk_cell_renderer_render(GTK_CELL_RENDERER(self->icon_render), pixmap, widget, &rect, &rect, &rect, state);
+    cairo_set_source_surface(cr, cairo_get_target(pixmap_cr), 0, 0);
+    cairo_paint(cr);
+    cairo_destroy(pixmap_cr);
+    g_object_unref(pixmap);
+#endif
+
+    cairo_destroy(cr);
+    return surface;
+}
+
+/* Returns the surface to blit for the icon of the item, rendering the
+   variant for the state once, or NULL if the renderer has to draw it.
+   A plain icon is the size of the pixbuf, to be centered in the icon rect;
+   a variant is the size of the icon rect. */
+static cairo_surface_t* get_icon_surface(FmDesktop* self, FmDesktopItem* item, GdkPixbuf* icon, GtkCellRendererState state)
+{
+    int width = item->icon_rect.width;
+    int height = item->icon_rect.height;
+    cairo_surface_t* surface;
+    guint variant = 0;
+
+    if (state & GTK_CELL_RENDERER_SELECTED)
+        variant |= ICON_VARIANT_SELECTED;
+    if (fm_file_info_is_symlink(item->fi))
+        variant |= ICON_VARIANT_LINK;
+
+    /* the renderer would just center the pixbuf */
+    if (variant == 0)
+        return icon_surface_cache_lookup(icon);
+
+    surface = icon_surface_cache_lookup_variant(icon, variant, width, height);
+    if (!surface)
+    {
+        surface = render_icon_variant(self, item, icon, state, width, height);
+        if (surface)
+            icon_surface_cache_insert_variant(icon, variant, width, height, surface);
+    }
+    return surface;
+}
+
+/* Paints the item shifted by (-dx, -dy). With GTK+ 2 the cell renderer draws to
+   window directly, so it is the drawable behind cr: the desktop window or a tile
+   pixmap (both are GdkDrawable there). */
+static void paint_item(FmDesktop* self, FmDesktopItem* item, cairo_t* cr, GdkWindow* window, int dx, int dy, GdkRectangle* expose_area, GdkPixbuf* icon)
+{
+#if GTK_CHECK_VERSION(3, 0, 0)
+    GtkStyleContext* style;
+#else
+    GtkStyle* style;
+#endif
+    GtkWidget* widget = (GtkWidget*)self;
+    GtkCellRendererState state = 0;
+#if GTK_CHECK_VERSION(3, 0, 0)
+    GdkRGBA rgba;
+#endif
+    int text_x, text_y;
+    GdkRectangle icon_rect, text_rect;
+    cairo_surface_t* surface;
+    gboolean selected = item->is_selected || item == self->drop_hilight;
+    gboolean render_labels;
+
+#if GTK_CHECK_VERSION(3, 0, 0)
+    style = gtk_widget_get_style_context(widget);
+#else
+    style = gtk_widget_get_style(widget);
+#endif
+
+    /* on a cache hit the masks are just blitted, the layout is not needed */
+    render_labels = item_labels_need_rendering(self, item, !selected);
+    if (render_labels)
+        set_item_layout_text(self, item);
+
+    /* FIXME: do we need to cache this? */
+    text_x = item->x + (self->cell_w - self->text_w)/2 + 2 - dx;
+    text_y = item->icon_rect.y + item->icon_rect.height + 2 - dy;
+
+    icon_rect = item->icon_rect;
+    icon_rect.x -= dx;
+    icon_rect.y -= dy;
+    text_rect = item->text_rect;
+    text_rect.x -= dx;
+    text_rect.y -= dy;
+
+    if(selected) /* draw background for text label */
+    {
+        state = GTK_CELL_RENDERER_SELECTED;
+
+        cairo_save(cr);
+        gdk_cairo_rectangle(cr, &text_rect);
+#if GTK_CHECK_VERSION(3, 0, 0)
+        gtk_style_context_get_background_color(style, GTK_STATE_FLAG_SELECTED, &rgba);
+        gdk_cairo_set_source_rgba(cr, &rgba);
+#else
+        gdk_cairo_set_source_color(cr, &style->bg[GTK_STATE_SELECTED]);
+#endif
+        cairo_clip(cr);
+        cairo_paint(cr);
+        cairo_restore(cr);
+#if GTK_CHECK_VERSION(3, 0, 0)
+        gtk_style_context_get_color(style, GTK_STATE_FLAG_SELECTED, &rgba);
+        gdk_cairo_set_source_rgba(cr, &rgba);
+#else
+        gdk_cairo_set_source_color(cr, &style->fg[GTK_STATE_SELECTED]);
+#endif
+    }
+    else
+    {
+        /* the shadow */
+
+        const BlurKernel* shadow_blur;
+        const shadow_style_t* shadow = get_shadow_style(&shadow_blur);
+
+        gdk_cairo_set_source_color(cr, &app_config->desktop_shadow);
+        cairo_move_to(cr, text_x + shadow->offset, text_y + shadow->offset);
+        //pango_cairo_show_layout(cr, self->pl);
+        paint_item_text(self, item, &item->cached_text_shadow, shadow_blur, cr);
+        gdk_cairo_set_source_color(cr, &app_config->desktop_fg);
+    }
+
+    /* real text */
+    cairo_move_to(cr, text_x, text_y);
+    /* FIXME: should we check if pango is 1.10 at least? */
+    //pango_cairo_show_layout(cr, self->pl);
+    paint_item_text(self, item, &item->cached_text, NULL, cr);
+    if (render_labels)
+        pango_layout_set_text(self->pl, NULL, 0);
+
+    if (item == self->focus && gtk_window_is_active((GtkWindow *) self))
+    {
+#if GTK_CHECK_VERSION(3, 0, 0)
+        gtk_render_focus(style, cr,
+#else
+        gtk_paint_focus(style, window, gtk_widget_get_state(widget),
+                        expose_area, widget, "icon_view",
+#endif
+                        text_rect.x, text_rect.y, text_rect.width, text_rect.height);
+    }
+
+    /* draw the icon */
+    if (!icon)
+        return;
+    surface = get_icon_surface(self, item, icon, state);
+    if (surface)
+    {
+        int width = cairo_image_surface_get_width(surface);
+        int height = cairo_image_surface_get_height(surface);
+        cairo_save(cr);
+        cairo_set_source_surface(cr, surface,
+            icon_rect.x + (icon_rect.width - width) / 2,
+            icon_rect.y + (icon_rect.height - height) / 2);
+        cairo_paint(cr);
+        cairo_restore(cr);
+        cairo_surface_destroy(surface);
+        return;
+    }
+    g_object_set(self->icon_render, "pixbuf", icon, "info", item->fi, NULL);
+#if GTK_CHECK_VERSION(3, 0, 0)
+    gtk_cell_renderer_render(GTK_CELL_RENDERER(self->icon_render), cr, widget, &icon_rect, &icon_rect, state);
+#else
+    gtk_cell_renderer_render(GTK_CELL_RENDERER(self->icon_render), window, widget, &icon_rect, &icon_rect, expose_area, state);
+#endif
+}
+
+/****************************************************************************/
+
+/* Label warm-up: once the layout is done, the label masks of the visible
+   items are rendered in idle slices, before the frame that shows them, so
+   the frame itself only has to blit them. */
+
+/* Renders the masks the item would need to be painted now. */
+static void warm_up_item_labels(FmDesktop* self, FmDesktopItem* item, cairo_surface_t* target)
+{
+    gboolean shadow = !(item->is_selected || item == self->drop_hilight);
+    const BlurKernel* shadow_blur = NULL;
+
+    if (!item_labels_need_rendering(self, item, shadow))
+        return;
+
+    if (shadow)
+        get_shadow_style(&shadow_blur);
+
+    set_item_layout_text(self, item);
+    if (shadow)
+        render_item_text(self, item, &item->cached_text_shadow, shadow_blur, target);
+    render_item_text(self, item, &item->cached_text, NULL, target);
+    pango_layout_set_text(self->pl, NULL, 0);
+}
+
+static gboolean on_idle_warm_up_labels(FmDesktop* self)
+{
+    GtkTreeModel* model = GTK_TREE_MODEL(self->model);
+    GdkWindow* window = gtk_widget_get_window((GtkWidget*)self);
+    cairo_surface_t* target;
+    GtkAllocation allocation;
+    GtkTreeIter it;
+    gint64 deadline = G_MAXINT64;
+    gboolean more;
+    guint n = 0;
+
+    if (!window || !app_config->show_icons)
+    {
+        self->idle_warm_up = 0;
+        return FALSE;
+    }
+
+    if (app_config->layout_time_slice > 0)
+        deadline = g_get_monotonic_time() + (gint64)app_config->layout_time_slice * 1000;
+
+    gtk_widget_get_allocation((GtkWidget*)self, &allocation);
+    allocation.x = allocation.y = 0;
+    target = gdk_window_create_similar_surface(window, CAIRO_CONTENT_ALPHA, 1, 1);
+
+    more = gtk_tree_model_iter_nth_child(model, &it, NULL, self->warm_up_row);
+    while (more)
+    {
+        FmDesktopItem* item = fm_folder_model_get_item_userdata(self->model, &it);
+        GdkRectangle rect;
+
+        self->warm_up_row++;
+        if (item && !item->is_virtual)
+        {
+            get_item_rect(item, &rect);
+            if (gdk_rectangle_intersect(&allocation, &rect, NULL))
+                warm_up_item_labels(self, item, target);
+        }
+        more = gtk_tree_model_iter_next(model, &it);
+        if (more && ++n % LAYOUT_CLOCK_INTERVAL == 0 && g_get_monotonic_time() >= deadline)
+        {
+            cairo_surface_destroy(target);
+            return TRUE; /* continue in the next slice */
+        }
+    }
+
+    cairo_surface_destroy(target);
+    self->idle_warm_up = 0;
+    return FALSE;
+}
+
+static void cancel_warm_up_labels(FmDesktop* desktop)
+{
+    if (desktop->idle_warm_up)
+    {
+        g_source_remove(desktop->idle_warm_up);
+        desktop->idle_warm_up = 0;
+    }
+}
+
+static void queue_warm_up_labels(FmDesktop* desktop)
+{
+    desktop->warm_up_row = 0;
+    /* ahead of the redraw, which would render the labels itself otherwise */
+    if (0 == desktop->idle_warm_up)
+        desktop->idle_warm_up = g_idle_add_full(GDK_PRIORITY_REDRAW - 1,
+            (GSourceFunc)on_idle_warm_up_labels, desktop, NULL);
+}
+
+/****************************************************************************/
+
+static guint get_item_tile_state(FmDesktop* self, FmDesktopItem* item)
+{
+    guint state = 0;
+    if (item->is_selected || item == self->drop_hilight)
+        state |= ITEM_TILE_SELECTED;
+    if (item == self->focus && gtk_window_is_active((GtkWindow *) self))
+        state |= ITEM_TILE_FOCUSED;
+    return state;
+}
+
+static inline gboolean rect_equal_shifted(const GdkRectangle* a, const GdkRectangle* b, int dx, int dy)
+{
+    return a->x + dx == b->x && a->y + dy == b->y && a->width == b->width && a->height == b->height;
+}
+
+/* The tile stays valid while the item is only moved around. */
+static gboolean item_tile_is_valid(FmDesktop* self, FmDesktopItem* item, guint state)
+{
+    item_tile_t * tile = &item->tile;
+    int dx, dy;
+
+    if (!tile->surface)
+        return FALSE;
+    if (tile->timestamp != self->tile_timestamp || tile->state != state)
+        return FALSE;
+
+    dx = item->icon_rect.x - tile->icon_rect.x;
+    dy = item->icon_rect.y - tile->icon_rect.y;
+    return rect_equal_shifted(&tile->icon_rect, &item->icon_rect, dx, dy)
+        && rect_equal_shifted(&tile->text_rect, &item->text_rect, dx, dy);
+}
+
+static gboolean render_item_tile(FmDesktop* self, FmDesktopItem* item, GdkPixbuf* icon, guint state)
+{
+    item_tile_t * tile = &item->tile;
+    GdkWindow* window = gtk_widget_get_window((GtkWidget*)self);
+    GdkRectangle rect;
+    gsize bytes;
+    cairo_t* cr;
+
+    item_tile_invalidate(tile);
+    get_item_tile_rect(item, &rect);
+    bytes = (gsize) rect.width * rect.height * 4;
+    if (!trim_item_tiles(bytes))
+        return FALSE;
+
+#if GTK_CHECK_VERSION(3, 0, 0)
+    tile->surface = gdk_window_create_similar_surface(window, CAIRO_CONTENT_COLOR_ALPHA,
+                                                      rect.width, rect.height);
+    if (cairo_surface_status(tile->surface) != CAIRO_STATUS_SUCCESS)
+    {
+        item_tile_invalidate(tile);
+        return FALSE;
+    }
+    cr = cairo_create(tile->surface);
+#else
+    /* the cell renderer needs a drawable, so the tile is an ARGB pixmap */
+    GdkColormap* colormap = gdk_screen_get_rgba_colormap(gtk_widget_get_screen((GtkWidget*)self));
+    if (!colormap)
+        return FALSE;
+    tile->pixmap = gdk_pixmap_new(window, rect.width, rect.height,
+                                  gdk_colormap_get_visual(colormap)->depth);
+    gdk_drawable_set_colormap(tile->pixmap, colormap);
+    cr = gdk_cairo_create(tile->pixmap);
+    tile->surface = cairo_surface_reference(cairo_get_target(cr));
+    cairo_save(cr);
+    cairo_set_operator(cr, CAIRO_OPERATOR_CLEAR);
+    cairo_paint(cr);
+    cairo_restore(cr);
+#endif
+
+    {
+        GdkRectangle area = {0, 0, rect.width, rect.height};
+#if GTK_CHECK_VERSION(3, 0, 0)
+        paint_item(self, item, cr, window, rect.x, rect.y, &area, icon);
+#else
+        paint_item(self, item, cr, tile->pixmap, rect.x, rect.y, &area, icon);
+#endif
+    }
+    cairo_destroy(cr);
+
+    tile->timestamp = self->tile_timestamp;
+    tile->state = state;
+    tile->icon_rect = item->icon_rect;
+    tile->text_rect = item->text_rect;
+    tile->bytes = bytes;
+    tile->link.data = tile;
+    g_queue_push_head_link(&item_tiles, &tile->link);
+    item_tile_stats.bytes += bytes;
+    item_tile_stats.misses++;
+    return TRUE;
+}
+
+/* finds the row of the item, trying the row it was laid out at first */
+static gboolean get_item_iter(FmDesktop* self, FmDesktopItem* item, GtkTreeIter* it)
+{
+    GtkTreeModel* model = GTK_TREE_MODEL(self->model);
+
+    if(gtk_tree_model_iter_nth_child(model, it, NULL, item->z)
+    && fm_folder_model_get_item_userdata(self->model, it) == item)
+        return TRUE;
+
+    if(gtk_tree_model_get_iter_first(model, it)) do
+    {
+        if(fm_folder_model_get_item_userdata(self->model, it) == item)
+            return TRUE;
+    }
+    while(gtk_tree_model_iter_next(model, it));
+    return FALSE;
+}
+
+/* Blits the item tile to the area, rendering the tile first if needed. */
+static void paint_item_tile(FmDesktop* self, FmDesktopItem* item, cairo_t* cr, GdkRectangle* area)
+{
+    guint state = get_item_tile_state(self, item);
+    GdkRectangle rect;
+
+    if (!item_tile_is_valid(self, item, state))
+    {
+        GdkPixbuf* icon = NULL;
+        GtkTreeIter it;
+        gboolean rendered;
+
+        if(!get_item_iter(self, item, &it))
+            return;
+        gtk_tree_model_get(GTK_TREE_MODEL(self->model), &it, FM_FOLDER_MODEL_COL_ICON_WITH_THUMBNAIL, &icon, -1);
+        rendered = render_item_tile(self, item, icon, state);
+        if (!rendered) /* no tile, paint the item in place */
+            paint_item(self, item, cr, gtk_widget_get_window((GtkWidget*)self), 0, 0, area, icon);
+        if(icon)
+            g_object_unref(icon);
+        if (!rendered)
+            return;
+    }
+    else
+    {
+        g_queue_unlink(&item_tiles, &item->tile.link);
+        g_queue_push_head_link(&item_tiles, &item->tile.link);
+        item_tile_stats.hits++;
+    }
+
+    get_item_tile_rect(item, &rect);
+    cairo_save(cr);
+    cairo_set_source_surface(cr, item->tile.surface, rect.x, rect.y);
+    gdk_cairo_rectangle(cr, area);
+    cairo_fill(cr);
+    cairo_restore(cr);
+}
+
+/* paints all items that intersect the area, in the model order */
+static void paint_items(FmDesktop* self, cairo_t* cr, GdkRectangle* area)
+{
+    ItemGeometry* geometry = self->items_geometry;
+    int margin = get_item_tile_margin();
+    GdkRectangle query;
+    guint i;
+
+    /* a tile reaches margin pixels beyond the icon and text rects */
+    query.x = area->x - margin;
+    query.y = area->y - margin;
+    query.width = area->width + margin * 2;
+    query.height = area->height + margin * 2;
+
+    /* the slots are in the model order */
+    sync_items_geometry(self);
+    rect_batch_intersect(geometry->icon_rects, geometry->n_items, &query, geometry->icon_hits);
+    rect_batch_intersect(geometry->text_rects, geometry->n_items, &query, geometry->text_hits);
+
+    for(i = 0; i < RECT_BATCH_MASK_WORDS(geometry->n_items); i++)
+    {
+        guint32 hits = geometry->icon_hits[i] | geometry->text_hits[i];
+        while(hits)
+        {
+            guint index = i * 32 + g_bit_nth_lsf(hits, -1);
+            FmDesktopItem* item = geometry->items[index];
+            GdkRectangle rect, intersect;
+
+            hits &= hits - 1;
+            if(!item || (geometry->flags[index] & ITEM_GEOMETRY_VIRTUAL))
+                continue;
+            get_item_tile_rect(item, &rect);
+            if(gdk_rectangle_intersect(area, &rect, &intersect))
+                paint_item_tile(self, item, cr, &intersect);
+        }
+    }
+}
+
+/* ---------------------------------------------------------------------
+    The icon layer: all items composited into one window-sized surface,
+    so an expose is a plain copy. Only the areas marked dirty are painted
+    into it again. */
+
+/* more dirty areas than this are not worth tracking one by one */
+#define ICON_LAYER_MAX_DIRTY_RECTS 32
+
+static void free_icon_layer(FmDesktop* self)
+{
+    if (self->icon_layer)
+    {
+        cairo_surface_destroy(self->icon_layer);
+        self->icon_layer = NULL;
+    }
+    if (self->icon_layer_dirty)
+        g_array_set_size(self->icon_layer_dirty, 0);
+}
+
+/* marks the whole layer to be painted again */
+static void invalidate_icon_layer(FmDesktop* self)
+{
+    self->icon_layer_invalid = TRUE;
+    if (self->icon_layer_dirty)
+        g_array_set_size(self->icon_layer_dirty, 0);
+}
 
-            cairo_mask_surface(cr3, cache->surface, -c45, c45);
-            cairo_fill(cr3);
+static void invalidate_icon_layer_rect(FmDesktop* self, const GdkRectangle* rect)
+{
+    GdkRectangle dirty = *rect;
+    guint i;
 
-            cairo_mask_surface(cr3, cache->surface, -c45, -c45);
-            cairo_fill(cr3);
+    if (!self->icon_layer || self->icon_layer_invalid)
+        return;
 
-            cairo_destroy(cr3);
+    if (!self->icon_layer_dirty)
+        self->icon_layer_dirty = g_array_new(FALSE, FALSE, sizeof(GdkRectangle));
 
-            cairo_surface_destroy(cache->surface);
-            cache->surface = surface;
+    /* merge the overlapping areas, so no pixel gets painted twice */
+    for (i = 0; i < self->icon_layer_dirty->len; )
+    {
+        GdkRectangle* r = &g_array_index(self->icon_layer_dirty, GdkRectangle, i);
+        if (gdk_rectangle_intersect(r, &dirty, NULL))
+        {
+            gdk_rectangle_union(r, &dirty, &dirty);
+            g_array_remove_index_fast(self->icon_layer_dirty, i);
+            i = 0;
         }
+        else
+            i++;
     }
 
-    double x, y;
-    cairo_get_current_point(cr, &x, &y);
-    cairo_mask_surface(cr, cache->surface, x, y);
-    cairo_fill(cr);
+    if (self->icon_layer_dirty->len >= ICON_LAYER_MAX_DIRTY_RECTS)
+        invalidate_icon_layer(self);
+    else
+        g_array_append_val(self->icon_layer_dirty, dirty);
+}
 
+static void paint_icon_layer_area(FmDesktop* self, cairo_t* cr, GdkRectangle* area)
+{
+    cairo_save(cr);
+    cairo_set_operator(cr, CAIRO_OPERATOR_CLEAR);
+    gdk_cairo_rectangle(cr, area);
+    cairo_fill(cr);
     cairo_restore(cr);
+    paint_items(self, cr, area);
 }
 
-
-static void paint_item(FmDesktop* self, FmDesktopItem* item, cairo_t* cr, GdkRectangle* expose_area, GdkPixbuf* icon, gdouble item_opacity)
+/* Brings the layer up to date. Returns FALSE if the items can not be
+   composited off screen and have to be painted in place. */
+static gboolean update_icon_layer(FmDesktop* self, cairo_t* target)
 {
-#if GTK_CHECK_VERSION(3, 0, 0)
-    GtkStyleContext* style;
-#else
-    GtkStyle* style;
-#endif
-    GtkWidget* widget = (GtkWidget*)self;
-    GtkCellRendererState state = 0;
-#if GTK_CHECK_VERSION(3, 0, 0)
-    GdkRGBA rgba;
-#else
-    GdkWindow* window;
-#endif
-    int text_x, text_y;
+    GtkAllocation allocation;
+    cairo_t* cr;
 
-#if GTK_CHECK_VERSION(3, 0, 0)
-    style = gtk_widget_get_style_context(widget);
-#else
-    style = gtk_widget_get_style(widget);
-    window = gtk_widget_get_window(widget);
+#if !GTK_CHECK_VERSION(3, 0, 0)
+    /* the item tiles need an ARGB visual */
+    if (!gdk_screen_get_rgba_colormap(gtk_widget_get_screen((GtkWidget*)self)))
+        return FALSE;
 #endif
 
-    pango_layout_set_text(self->pl, NULL, 0);
-    pango_layout_set_width(self->pl, self->pango_text_w);
-    pango_layout_set_height(self->pl, self->pango_text_h);
+    gtk_widget_get_allocation((GtkWidget*)self, &allocation);
 
-    pango_layout_set_text(self->pl, fm_file_info_get_disp_name(item->fi), -1);
+    if (!self->icon_layer)
+    {
+        self->icon_layer = cairo_surface_create_similar(cairo_get_target(target),
+            CAIRO_CONTENT_COLOR_ALPHA, allocation.width, allocation.height);
+        if (cairo_surface_status(self->icon_layer) != CAIRO_STATUS_SUCCESS)
+        {
+            free_icon_layer(self);
+            return FALSE;
+        }
+        invalidate_icon_layer(self);
+    }
 
-    /* FIXME: do we need to cache this? */
-    text_x = item->x + (self->cell_w - self->text_w)/2 + 2;
-    text_y = item->icon_rect.y + item->icon_rect.height + 2;
+    if (!self->icon_layer_invalid && (!self->icon_layer_dirty || self->icon_layer_dirty->len == 0))
+        return TRUE;
 
-    if(item->is_selected || item == self->drop_hilight) /* draw background for text label */
+    cr = cairo_create(self->icon_layer);
+    if (self->icon_layer_invalid)
     {
-        state = GTK_CELL_RENDERER_SELECTED;
-
-        cairo_save(cr);
-        gdk_cairo_rectangle(cr, &item->text_rect);
-#if GTK_CHECK_VERSION(3, 0, 0)
-        gtk_style_context_get_background_color(style, GTK_STATE_FLAG_SELECTED, &rgba);
-        gdk_cairo_set_source_rgba(cr, &rgba);
-#else
-        gdk_cairo_set_source_color(cr, &style->bg[GTK_STATE_SELECTED]);
-#endif
-        cairo_clip(cr);
-        cairo_paint(cr);
-        cairo_restore(cr);
-#if GTK_CHECK_VERSION(3, 0, 0)
-        gtk_style_context_get_color(style, GTK_STATE_FLAG_SELECTED, &rgba);
-        gdk_cairo_set_source_rgba(cr, &rgba);
-#else
-        gdk_cairo_set_source_color(cr, &style->fg[GTK_STATE_SELECTED]);
-#endif
+        GdkRectangle area = {0, 0, allocation.width, allocation.height};
+        paint_icon_layer_area(self, cr, &area);
+        self->icon_layer_invalid = FALSE;
     }
     else
     {
-        /* the shadow */
-
-        float shadow_offset = 0;
-        float shadow_blur_radius = 0;
-
-        /* TODO: should user-configurable */
+        guint i;
+        for (i = 0; i < self->icon_layer_dirty->len; i++)
+            paint_icon_layer_area(self, cr, &g_array_index(self->icon_layer_dirty, GdkRectangle, i));
+    }
+    cairo_destroy(cr);
 
-        // Thin
-        //shadow_offset = 1.0;
-        //shadow_blur_radius = 0.0;
+    if (self->icon_layer_dirty)
+        g_array_set_size(self->icon_layer_dirty, 0);
+    return TRUE;
+}
 
-        // Normal
-        shadow_offset = 1.0;
-        shadow_blur_radius = 0.7;
+/* repaints all items, e.g. after they were laid out again */
+static void queue_draw_items(FmDesktop* self)
+{
+    invalidate_icon_layer(self);
+    gtk_widget_queue_draw(GTK_WIDGET(self));
+}
 
-        // Bold
-        //shadow_offset = 1.3;
-        //shadow_blur_radius = 1.5;
+/* ---------------------------------------------------------------------
+    Damage accumulated between frames, so changing many items at once
+    (e.g. selecting all of them) invalidates the window only once. */
 
-        // Bold 2
-        //shadow_offset = 1.5;
-        //shadow_blur_radius = 2.0;
+static void flush_damage(FmDesktop* desktop)
+{
+    GdkWindow* window = gtk_widget_get_window(GTK_WIDGET(desktop));
 
-        gdk_cairo_set_source_color(cr, &app_config->desktop_shadow);
-        cairo_move_to(cr, text_x + shadow_offset, text_y + shadow_offset);
-        //pango_cairo_show_layout(cr, self->pl);
-        paint_item_text(self, item, &item->cached_text_shadow, shadow_blur_radius, cr);
-        gdk_cairo_set_source_color(cr, &app_config->desktop_fg);
+    if(window && desktop->damage)
+        gdk_window_invalidate_region(window, desktop->damage, FALSE);
+    if(desktop->damage)
+    {
+#if GTK_CHECK_VERSION(3, 0, 0)
+        cairo_region_destroy(desktop->damage);
+#else
+        gdk_region_destroy(desktop->damage);
+#endif
+        desktop->damage = NULL;
     }
+}
 
-    /* real text */
-    cairo_move_to(cr, text_x, text_y);
-    /* FIXME: should we check if pango is 1.10 at least? */
-    //pango_cairo_show_layout(cr, self->pl);
-    paint_item_text(self, item, &item->cached_text, 0, cr);
-    pango_layout_set_text(self->pl, NULL, 0);
+#if GTK_CHECK_VERSION(3, 8, 0)
+/* runs at the start of a frame, before it is painted */
+static gboolean on_damage_tick(GtkWidget* widget, GdkFrameClock* frame_clock, gpointer user_data)
+{
+    FmDesktop* desktop = (FmDesktop*)widget;
+    desktop->damage_flush_handler = 0;
+    flush_damage(desktop);
+    return FALSE;
+}
+#else
+static gboolean on_damage_idle(gpointer user_data)
+{
+    FmDesktop* desktop = (FmDesktop*)user_data;
+    desktop->damage_flush_handler = 0;
+    flush_damage(desktop);
+    return FALSE;
+}
+#endif
 
-    if (item == self->focus && gtk_window_is_active((GtkWindow *) self))
+static void cancel_damage(FmDesktop* desktop)
+{
+    if(desktop->damage_flush_handler)
+    {
+#if GTK_CHECK_VERSION(3, 8, 0)
+        gtk_widget_remove_tick_callback(GTK_WIDGET(desktop), desktop->damage_flush_handler);
+#else
+        g_source_remove(desktop->damage_flush_handler);
+#endif
+        desktop->damage_flush_handler = 0;
+    }
+    if(desktop->damage)
     {
 #if GTK_CHECK_VERSION(3, 0, 0)
-        gtk_render_focus(style, cr,
+        cairo_region_destroy(desktop->damage);
 #else
-        gtk_paint_focus(style, window, gtk_widget_get_state(widget),
-                        expose_area, widget, "icon_view",
+        gdk_region_destroy(desktop->damage);
 #endif
-                        item->text_rect.x, item->text_rect.y, item->text_rect.width, item->text_rect.height);
+        desktop->damage = NULL;
     }
+}
+
+static void queue_damage(FmDesktop* desktop, GdkRectangle* rect)
+{
+    if(!gtk_widget_get_window(GTK_WIDGET(desktop)))
+        return;
 
-    /* draw the icon */
-    g_object_set(self->icon_render, "pixbuf", icon, "info", item->fi, NULL);
 #if GTK_CHECK_VERSION(3, 0, 0)
-    gtk_cell_renderer_render(GTK_CELL_RENDERER(self->icon_render), cr, widget, &item->icon_rect, &item->icon_rect, state);
+    if(!desktop->damage)
+        desktop->damage = cairo_region_create_rectangle(rect);
+    else
+        cairo_region_union_rectangle(desktop->damage, rect);
+#else
+    if(!desktop->damage)
+        desktop->damage = gdk_region_rectangle(rect);
+    else
+        gdk_region_union_with_rect(desktop->damage, rect);
+#endif
+
+    if(!desktop->damage_flush_handler)
+    {
+#if GTK_CHECK_VERSION(3, 8, 0)
+        desktop->damage_flush_handler = gtk_widget_add_tick_callback(GTK_WIDGET(desktop),
+                                                                     on_damage_tick, NULL, NULL);
 #else
-    gtk_cell_renderer_render(GTK_CELL_RENDERER(self->icon_render), window, widget, &item->icon_rect, &item->icon_rect, expose_area, state);
+        /* just before GDK processes the window updates */
+        desktop->damage_flush_handler = g_idle_add_full(GDK_PRIORITY_REDRAW - 1,
+                                                        on_damage_idle, desktop, NULL);
 #endif
+    }
 }
 
 static void redraw_item(FmDesktop* desktop, FmDesktopItem* item)
 {
+    GdkWindow* window = gtk_widget_get_window(GTK_WIDGET(desktop));
     GdkRectangle rect;
-    gdk_rectangle_union(&item->icon_rect, &item->text_rect, &rect);
-    --rect.x;
-    --rect.y;
-    rect.width += 2;
-    rect.height += 2;
-    gdk_window_invalidate_rect(gtk_widget_get_window(GTK_WIDGET(desktop)), &rect, FALSE);
+    if(!window)
+        return;
+    get_item_tile_rect(item, &rect);
+    invalidate_icon_layer_rect(desktop, &rect);
+    queue_damage(desktop, &rect);
 }
 
 static void move_item(FmDesktop* desktop, FmDesktopItem* item, int x, int y, gboolean redraw)
 {
-    int dx, dy;
     /* this call invalid the area occupied by the item and a redraw
      * is queued. */
     if(redraw)
         redraw_item(desktop, item);
 
-    dx = x - item->x;
-    dy = y - item->y;
-
-    item->x = x;
-    item->y = y;
-
     /* calc_item_size(desktop, item); */
-    item->icon_rect.x += dx;
-    item->icon_rect.y += dy;
-    item->text_rect.x += dx;
-    item->text_rect.y += dy;
+    set_item_position(desktop, item, x, y);
 
     /* make the item use customized fixed position. */
-    if(!item->fixed_pos)
-    {
-        item->fixed_pos = TRUE;
-        desktop->fixed_items = g_list_prepend(desktop->fixed_items, item);
-    }
+    fix_item_pos(desktop, item);
 
     /* move the item to a new place, and queue a redraw for the new rect. */
     if(redraw)
@@ -814,19 +2528,18 @@ static void update_rubberbanding(FmDesktop* self, int newx, int newy)
     if (!app_config->show_icons)
         return;
 
-    GtkTreeModel* model = GTK_TREE_MODEL(self->model);
-    GtkTreeIter it;
+    ItemGeometry* geometry = self->items_geometry;
     GdkRectangle old_rect, new_rect;
+    guint32* hits;
+    guint i;
     //GdkRegion *region;
-    GdkWindow *window;
-
-    window = gtk_widget_get_window(GTK_WIDGET(self));
 
+    sync_items_geometry(self);
     calc_rubber_banding_rect(self, self->rubber_banding_x, self->rubber_banding_y, &old_rect);
     calc_rubber_banding_rect(self, newx, newy, &new_rect);
 
-    gdk_window_invalidate_rect(window, &old_rect, FALSE);
-    gdk_window_invalidate_rect(window, &new_rect, FALSE);
+    queue_damage(self, &old_rect);
+    queue_damage(self, &new_rect);
 //    gdk_window_clear_area(((GtkWidget*)self)->window, new_rect.x, new_rect.y, new_rect.width, new_rect.height);
 /*
     region = gdk_region_rectangle(&old_rect);
@@ -840,17 +2553,19 @@ static void update_rubberbanding(FmDesktop* self, int newx, int newy)
     self->rubber_banding_y = newy;
 
     /* update selection */
-    if(gtk_tree_model_get_iter_first(model, &it)) do
+    hits = geometry->icon_hits;
+    rect_batch_intersect(geometry->icon_rects, geometry->n_items, &new_rect, hits);
+    rect_batch_intersect(geometry->text_rects, geometry->n_items, &new_rect, geometry->text_hits);
+    for(i = 0; i < RECT_BATCH_MASK_WORDS(geometry->n_items); i++)
+        hits[i] |= geometry->text_hits[i];
+
+    for(i = 0; i < geometry->n_items; i++)
     {
-        FmDesktopItem* item = fm_folder_model_get_item_userdata(self->model, &it);
-        CONTINUE_IF_ITEM_IS_NULL(item);
+        FmDesktopItem* item = geometry->items[i];
+        if(!item)
+            continue;
 
-        gboolean selected;
-        if(gdk_rectangle_intersect(&new_rect, &item->icon_rect, NULL) ||
-            gdk_rectangle_intersect(&new_rect, &item->text_rect, NULL))
-            selected = TRUE;
-        else
-            selected = FALSE;
+        gboolean selected = (hits[i / 32] >> (i % 32)) & 1;
 
         if(item->is_selected != selected)
         {
@@ -858,14 +2573,13 @@ static void update_rubberbanding(FmDesktop* self, int newx, int newy)
             redraw_item(self, item);
         }
     }
-    while(gtk_tree_model_iter_next(model, &it));
 }
 
 
 static void paint_rubber_banding_rect(FmDesktop* self, cairo_t* cr, GdkRectangle* expose_area)
 {
     GtkWidget* widget = (GtkWidget*)self;
-    GdkRectangle rect;
+    GdkRectangle rect, clip;
     GdkColor clr;
     guchar alpha;
 
@@ -874,7 +2588,8 @@ static void paint_rubber_banding_rect(FmDesktop* self, cairo_t* cr, GdkRectangle
     if(rect.width <= 0 || rect.height <= 0)
         return;
 
-    if(!gdk_rectangle_intersect(expose_area, &rect, &rect))
+    /* the area may be a piece of the rubber band, whose border is only at its real edges */
+    if(!gdk_rectangle_intersect(expose_area, &rect, &clip))
         return;
 /*
     gtk_widget_style_get(icon_view,
@@ -887,7 +2602,7 @@ static void paint_rubber_banding_rect(FmDesktop* self, cairo_t* cr, GdkRectangle
 
     cairo_save(cr);
     cairo_set_source_rgba(cr, (gdouble)clr.red/65535, (gdouble)clr.green/65536, (gdouble)clr.blue/65535, (gdouble)alpha/100);
-    gdk_cairo_rectangle(cr, &rect);
+    gdk_cairo_rectangle(cr, &clip);
     cairo_clip (cr);
     cairo_paint (cr);
     gdk_cairo_set_source_color(cr, &clr);
@@ -906,15 +2621,18 @@ static void paint_rubber_banding_rect(FmDesktop* self, cairo_t* cr, GdkRectangle
 static void on_row_deleting(FmFolderModel* model, GtkTreePath* tp,
                             GtkTreeIter* iter, gpointer data, FmDesktop* desktop)
 {
-    GList *l;
-
+    if(data)
+        redraw_item(desktop, data);
+    if(data && ((FmDesktopItem*)data)->fixed_pos)
+    {
+        unfix_item_pos(desktop, data);
+        /* items in the rows before may have skipped the cells it frees */
+        queue_layout_items(desktop);
+    }
+    if(data)
+        spatial_grid_remove(desktop->items_index, data);
+    mark_items_geometry_stale(desktop, gtk_tree_path_get_indices(tp)[0]);
     desktop_item_free(data);
-    for(l = desktop->fixed_items; l; l = l->next)
-        if(l->data == data)
-        {
-            desktop->fixed_items = g_list_delete_link(desktop->fixed_items, l);
-            break;
-        }
     if((gpointer)desktop->focus == data)
     {
         GtkTreeIter it = *iter;
@@ -941,13 +2659,15 @@ static void on_row_deleting(FmFolderModel* model, GtkTreePath* tp,
 static void on_row_inserted(FmFolderModel* mod, GtkTreePath* tp, GtkTreeIter* it, FmDesktop* desktop)
 {
     FmDesktopItem* item = desktop_item_new(mod, it);
+    gint row = gtk_tree_path_get_indices(tp)[0];
     fm_folder_model_set_item_userdata(mod, it, item);
-    queue_layout_items(desktop);
+    mark_items_geometry_stale(desktop, row);
+    queue_layout_items_from(desktop, row);
 }
 
 static void on_row_deleted(FmFolderModel* mod, GtkTreePath* tp, FmDesktop* desktop)
 {
-    queue_layout_items(desktop);
+    queue_layout_items_from(desktop, gtk_tree_path_get_indices(tp)[0]);
 }
 
 static void on_row_changed(FmFolderModel* model, GtkTreePath* tp, GtkTreeIter* it, FmDesktop* desktop)
@@ -960,6 +2680,8 @@ static void on_row_changed(FmFolderModel* model, GtkTreePath* tp, GtkTreeIter* i
         gtk_tree_model_get(GTK_TREE_MODEL(model), it, COL_FILE_INFO, &item->fi, -1);
         fm_file_info_ref(item->fi);
 
+        /* the icon or the emblems may have changed */
+        item_tile_invalidate(&item->tile);
         redraw_item(desktop, item);
         /* queue_layout_items(desktop); */
     } while (0);
@@ -967,7 +2689,17 @@ static void on_row_changed(FmFolderModel* model, GtkTreePath* tp, GtkTreeIter* i
 
 static void on_rows_reordered(FmFolderModel* model, GtkTreePath* parent_tp, GtkTreeIter* parent_it, gpointer arg3, FmDesktop* desktop)
 {
-    queue_layout_items(desktop);
+    /* only the rows from the first one that has changed its place need a relayout */
+    gint* new_order = (gint*)arg3;
+    gint n = gtk_tree_model_iter_n_children(GTK_TREE_MODEL(model), NULL);
+    gint i;
+    for(i = 0; i < n; i++)
+        if(new_order[i] != i)
+        {
+            mark_items_geometry_stale(desktop, i);
+            queue_layout_items_from(desktop, i);
+            break;
+        }
 }
 
 
@@ -1279,23 +3011,12 @@ static void on_fix_pos(GtkToggleAction* act, gpointer user_data)
     if(gtk_toggle_action_get_active(act))
     {
         for(l = items; l; l=l->next)
-        {
-            FmDesktopItem* item = (FmDesktopItem*)l->data;
-            if(!item->fixed_pos)
-            {
-                item->fixed_pos = TRUE;
-                desktop->fixed_items = g_list_prepend(desktop->fixed_items, item);
-            }
-        }
+            fix_item_pos(desktop, (FmDesktopItem*)l->data);
     }
     else
     {
         for(l = items; l; l=l->next)
-        {
-            FmDesktopItem* item = (FmDesktopItem*)l->data;
-            item->fixed_pos = FALSE;
-            desktop->fixed_items = g_list_remove(desktop->fixed_items, item);
-        }
+            unfix_item_pos(desktop, (FmDesktopItem*)l->data);
         layout_items(desktop);
     }
     g_list_free(items);
@@ -1359,34 +3080,51 @@ static gboolean is_point_in_rect(GdkRectangle* rect, int x, int y)
     return rect->x < x && x < (rect->x + rect->width) && y > rect->y && y < (rect->y + rect->height);
 }
 
+typedef struct _hit_test_data
+{
+    int x, y;
+    FmDesktopItem* item;
+} hit_test_data_t;
+
+/* keeps the topmost item under the point, i.e. the one painted last */
+static gboolean hit_test_item(gpointer data, const GdkRectangle* rect, gpointer user_data)
+{
+    FmDesktopItem* item = (FmDesktopItem*)data;
+    hit_test_data_t* hit = (hit_test_data_t*)user_data;
+
+    if(hit->item && item->z < hit->item->z)
+        return FALSE;
+    if(is_point_in_rect(&item->icon_rect, hit->x, hit->y)
+     || is_point_in_rect(&item->text_rect, hit->x, hit->y))
+        hit->item = item;
+    return FALSE;
+}
+
 static FmDesktopItem* hit_test(FmDesktop* self, GtkTreeIter *it, int x, int y)
 {
     if (!app_config->show_icons)
         return NULL;
 
-    FmDesktopItem* item;
-    GtkTreeModel* model = GTK_TREE_MODEL(self->model);
-    if(gtk_tree_model_get_iter_first(model, it)) do
-    {
-        item = fm_folder_model_get_item_userdata(self->model, it);
-        CONTINUE_IF_ITEM_IS_NULL(item);
-        if(is_point_in_rect(&item->icon_rect, x, y)
-         || is_point_in_rect(&item->text_rect, x, y))
-            return item;
-    }
-    while(gtk_tree_model_iter_next(model, it));
+    /* only the items sharing a cell of items_index with the point can be hit */
+    GdkRectangle rect = {x, y, 1, 1};
+    hit_test_data_t hit = {x, y, NULL};
+    sync_items_geometry(self);
+    spatial_grid_foreach_in_rect(self->items_index, &rect, hit_test_item, &hit);
+    if(hit.item && get_item_iter(self, hit.item, it))
+        return hit.item;
     return NULL;
 }
 
 static FmDesktopItem* get_nearest_item(FmDesktop* desktop, FmDesktopItem* item,  GtkDirectionType dir)
 {
-    GtkTreeModel * model = GTK_TREE_MODEL(desktop->model);
-    GtkTreeIter it;
+    ItemGeometry* geometry = desktop->items_geometry;
+    guint i;
 
-    if(!gtk_tree_model_get_iter_first(model, &it))
+    sync_items_geometry(desktop);
+    if(geometry->n_items == 0)
         return NULL;
     if(!item) /* there is no focused item yet, select first one then */
-        return fm_folder_model_get_item_userdata(desktop->model, &it);
+        return geometry->items[0];
 
     float d_left   = 1.5;
     float d_up     = 1.5;
@@ -1419,15 +3157,14 @@ static FmDesktopItem* get_nearest_item(FmDesktop* desktop, FmDesktopItem* item,
     FmDesktopItem * ret = NULL;
     float ret_distance = 0;
 
-    do
+    for (i = 0; i < geometry->n_items; i++)
     {
-        FmDesktopItem * item2 = fm_folder_model_get_item_userdata(desktop->model, &it);
-        CONTINUE_IF_ITEM_IS_NULL(item2);
-        if (item2 == item)
+        FmDesktopItem * item2 = geometry->items[i];
+        if (!item2 || item2 == item || (geometry->flags[i] & ITEM_GEOMETRY_VIRTUAL))
             continue;
 
-        float dx = (item->x - item2->x) * d_left;
-        float dy = (item->y - item2->y) * d_up;
+        float dx = (item->x - geometry->positions[i].x) * d_left;
+        float dy = (item->y - geometry->positions[i].y) * d_up;
 
         if (!vertical && dx < 0)
             continue;
@@ -1449,7 +3186,6 @@ static FmDesktopItem* get_nearest_item(FmDesktop* desktop, FmDesktopItem* item,
             ret_distance = distance;
         }
     }
-    while(gtk_tree_model_iter_next(model, &it));
 
     return ret;
 }
@@ -1562,12 +3298,14 @@ static gboolean on_expose(GtkWidget* w, GdkEventExpose* evt)
 #endif
 {
     FmDesktop* self = (FmDesktop*)w;
-#if !GTK_CHECK_VERSION(3, 0, 0)
+#if GTK_CHECK_VERSION(3, 0, 0)
+    cairo_rectangle_list_t* clip;
+#else
     cairo_t* cr;
 #endif
-    GtkTreeModel* model = GTK_TREE_MODEL(self->model);
-    GtkTreeIter it;
-    GdkRectangle area;
+    GdkRectangle* areas = NULL;
+    gint n_areas = 0, i;
+    gboolean use_icon_layer = FALSE;
 
     gdouble item_opacity = self->show_icons_transition_current / (gdouble) self->show_icons_transition_interval;
 
@@ -1577,54 +3315,65 @@ static gboolean on_expose(GtkWidget* w, GdkEventExpose* evt)
 
     cairo_save(cr);
     gtk_cairo_transform_to_window(cr, w, gtk_widget_get_window(w));
-    gdk_cairo_get_clip_rectangle(cr, &area);
+
+    /* paint the damaged rectangles one by one, not their bounding box */
+    clip = cairo_copy_clip_rectangle_list(cr);
+    if(clip->status == CAIRO_STATUS_SUCCESS)
+    {
+        areas = g_new(GdkRectangle, MAX(clip->num_rectangles, 1));
+        for(i = 0; i < clip->num_rectangles; i++)
+        {
+            cairo_rectangle_t* r = &clip->rectangles[i];
+            areas[n_areas].x = floor(r->x);
+            areas[n_areas].y = floor(r->y);
+            areas[n_areas].width = ceil(r->x + r->width) - areas[n_areas].x;
+            areas[n_areas].height = ceil(r->y + r->height) - areas[n_areas].y;
+            n_areas++;
+        }
+    }
+    else /* the clip is not made of rectangles */
+    {
+        areas = g_new(GdkRectangle, 1);
+        if(gdk_cairo_get_clip_rectangle(cr, areas))
+            n_areas = 1;
+    }
+    cairo_rectangle_list_destroy(clip);
 #else
     if(G_UNLIKELY(! gtk_widget_get_visible (w) || ! gtk_widget_get_mapped (w)))
         return TRUE;
 
     cr = gdk_cairo_create(gtk_widget_get_window(w));
-    area = evt->area;
+    gdk_region_get_rectangles(evt->region, &areas, &n_areas);
 #endif
 
-    if (app_config->show_icons)
-    {
-        if(self->rubber_banding)
-            paint_rubber_banding_rect(self, cr, &area);
-    }
-
     if (item_opacity > 0.0)
-    {
-        if(gtk_tree_model_get_iter_first(model, &it)) do
-        {
-            FmDesktopItem* item = fm_folder_model_get_item_userdata(self->model, &it);
-            CONTINUE_IF_ITEM_IS_NULL(item);
+        use_icon_layer = update_icon_layer(self, cr);
 
-            GdkRectangle* intersect, tmp, tmp2;
-            GdkPixbuf* icon = NULL;
-            if(gdk_rectangle_intersect(&area, &item->icon_rect, &tmp))
-                intersect = &tmp;
-            else
-                intersect = NULL;
+    for (i = 0; i < n_areas; i++)
+    {
+        GdkRectangle* area = &areas[i];
 
-            if(gdk_rectangle_intersect(&area, &item->text_rect, &tmp2))
-            {
-                if(intersect)
-                    gdk_rectangle_union(intersect, &tmp2, intersect);
-                else
-                    intersect = &tmp2;
-            }
+        if (app_config->show_icons)
+        {
+            if(self->rubber_banding)
+                paint_rubber_banding_rect(self, cr, area);
+        }
 
-            if(intersect)
+        if (item_opacity > 0.0)
+        {
+            if (use_icon_layer)
             {
-                gtk_tree_model_get(model, &it, FM_FOLDER_MODEL_COL_ICON_WITH_THUMBNAIL, &icon, -1);
-                paint_item(self, item, cr, intersect, icon, item_opacity);
-                if(icon)
-                    g_object_unref(icon);
+                cairo_set_source_surface(cr, self->icon_layer, 0, 0);
+                gdk_cairo_rectangle(cr, area);
+                cairo_fill(cr);
             }
+            else
+                paint_items(self, cr, area);
         }
-        while(gtk_tree_model_iter_next(model, &it));
     }
 
+    g_free(areas);
+
 #if GTK_CHECK_VERSION(3, 0, 0)
     cairo_restore(cr);
 #else
@@ -1637,6 +3386,11 @@ static gboolean on_expose(GtkWidget* w, GdkEventExpose* evt)
 static void on_size_allocate(GtkWidget* w, GtkAllocation* alloc)
 {
     FmDesktop* self = (FmDesktop*)w;
+    GtkAllocation old_allocation;
+
+    gtk_widget_get_allocation(w, &old_allocation);
+    if(old_allocation.width != alloc->width || old_allocation.height != alloc->height)
+        free_icon_layer(self);
 
     queue_layout_items(self);
 
@@ -2092,6 +3846,9 @@ static void on_style_set(GtkWidget* w, GtkStyle* prev)
     FmDesktop* self = (FmDesktop*)w;
 
     self->pango_timestamp++;
+    self->tile_timestamp++;
+    invalidate_icon_layer(self);
+    icon_surface_cache_clear_variants();
 
     PangoContext* pc = gtk_widget_get_pango_context(w);
     if (self->font_desc)
@@ -2124,6 +3881,12 @@ static void on_arrange_icons_in_rows_changed(FmConfig* cfg, GtkWidget* w)
     queue_layout_items(self);
 }
 
+static void on_hide_overflow_icons_changed(FmConfig* cfg, GtkWidget* w)
+{
+    FmDesktop * self = (FmDesktop *) w;
+    queue_layout_items(self);
+}
+
 static void on_realize(GtkWidget* w)
 {
     FmDesktop* self = (FmDesktop*)w;
@@ -2348,6 +4111,9 @@ static void on_dnd_src_data_get(FmDndSrc* ds, FmDesktop* desktop)
 
 static void on_icon_theme_changed(GtkIconTheme* theme, FmDesktop* desktop)
 {
+    desktop->tile_timestamp++;
+    invalidate_icon_layer(desktop);
+    icon_surface_cache_clear_variants();
     gtk_widget_queue_resize(GTK_WIDGET(desktop));
 }
 
@@ -2377,9 +4143,28 @@ static void on_desktop_font_changed(FmConfig* cfg, FmDesktop* desktop)
     queue_layout_items(desktop);
 }
 
+static void on_desktop_shadow_style_changed(FmConfig* cfg, FmDesktop* desktop)
+{
+    GtkTreeModel* model = GTK_TREE_MODEL(desktop->model);
+    GtkTreeIter it;
+
+    if(model && gtk_tree_model_get_iter_first(model, &it)) do
+    {
+        FmDesktopItem* item = fm_folder_model_get_item_userdata(desktop->model, &it);
+        CONTINUE_IF_ITEM_IS_NULL(item);
+        cached_layout_image_invalidate(&item->cached_text_shadow);
+    }
+    while(gtk_tree_model_iter_next(model, &it));
+
+    desktop->tile_timestamp++;
+    queue_draw_items(desktop);
+    queue_warm_up_labels(desktop);
+}
+
 static void on_desktop_text_changed(FmConfig* cfg, FmDesktop* desktop)
 {
-    gtk_widget_queue_draw(GTK_WIDGET(desktop));
+    desktop->tile_timestamp++;
+    queue_draw_items(desktop);
 }
 
 static void on_show_icons_changed(FmConfig* cfg, FmDesktop* desktop)
@@ -2477,6 +4262,8 @@ static inline void connect_model(FmDesktop* desktop)
 
 static inline void disconnect_model(FmDesktop* desktop)
 {
+    GtkTreeIter it;
+
     g_signal_handlers_disconnect_by_func(desktop_folder, on_folder_start_loading, desktop);
     g_signal_handlers_disconnect_by_func(desktop_folder, on_folder_finish_loading, desktop);
     g_signal_handlers_disconnect_by_func(desktop_folder, on_folder_error, desktop);
@@ -2486,6 +4273,20 @@ static inline void disconnect_model(FmDesktop* desktop)
     g_signal_handlers_disconnect_by_func(desktop->model, on_row_deleted, desktop);
     g_signal_handlers_disconnect_by_func(desktop->model, on_row_changed, desktop);
     g_signal_handlers_disconnect_by_func(desktop->model, on_rows_reordered, desktop);
+
+    /* free the items along with their tiles and label masks, which are
+       shared with the other desktops and would take their memory budget */
+    if(gtk_tree_model_get_iter_first(GTK_TREE_MODEL(desktop->model), &it)) do
+    {
+        FmDesktopItem* item = fm_folder_model_get_item_userdata(desktop->model, &it);
+        if(item)
+        {
+            fm_folder_model_set_item_userdata(desktop->model, &it, NULL);
+            desktop_item_free(item);
+        }
+    }
+    while(gtk_tree_model_iter_next(GTK_TREE_MODEL(desktop->model), &it));
+
     g_object_unref(desktop->model);
     desktop->model = NULL;
 }
@@ -2503,6 +4304,7 @@ static void fm_desktop_destroy(GtkObject *object)
     /* FIXME: what exactly this bug #3533958 is? */
     if(self->model) /* see bug #3533958 by korzhpavel@SF */
     {
+        save_layout_snapshot(self);
 
         pango_font_description_free(self->font_desc);
         self->font_desc = NULL;
@@ -2518,9 +4320,12 @@ static void fm_desktop_destroy(GtkObject *object)
         g_signal_handlers_disconnect_by_func(app_config, on_arrange_icons_rtl_changed, self);
         g_signal_handlers_disconnect_by_func(app_config, on_arrange_icons_btt_changed, self);
         g_signal_handlers_disconnect_by_func(app_config, on_arrange_icons_in_rows_changed, self);
+        g_signal_handlers_disconnect_by_func(app_config, on_hide_overflow_icons_changed, self);
         g_signal_handlers_disconnect_by_func(app_config, on_desktop_font_changed, self);
         g_signal_handlers_disconnect_by_func(app_config, on_desktop_text_changed, self);
+        g_signal_handlers_disconnect_by_func(app_config, on_desktop_shadow_style_changed, self);
         g_signal_handlers_disconnect_by_func(app_config, on_overlap_state_changed, self);
+        g_signal_handlers_disconnect_by_func(app_config, on_label_cache_size_changed, self);
 
         g_signal_handlers_disconnect_by_func(gtk_icon_theme_get_default(), on_icon_theme_changed, self);
 
@@ -2528,7 +4333,35 @@ static void fm_desktop_destroy(GtkObject *object)
 
         disconnect_model(self);
 
+        if(self->label_request)
+        {
+            text_measure_request_cancel(self->label_request);
+            self->label_request = NULL;
+        }
+
         unload_items(self);
+        g_array_free(self->fixed_rects, TRUE);
+        self->fixed_rects = NULL;
+        g_ptr_array_free(self->fixed_rect_items, TRUE);
+        self->fixed_rect_items = NULL;
+        g_array_free(self->fixed_rect_hits, TRUE);
+        self->fixed_rect_hits = NULL;
+        spatial_grid_free(self->items_index);
+        self->items_index = NULL;
+        item_geometry_free(self->items_geometry);
+        self->items_geometry = NULL;
+
+        cancel_damage(self);
+        cancel_warm_up_labels(self);
+
+        free_icon_layer(self);
+        log_label_cache_stats();
+        unref_label_atlas(gtk_widget_get_screen((GtkWidget*)self));
+        if(self->icon_layer_dirty)
+        {
+            g_array_free(self->icon_layer_dirty, TRUE);
+            self->icon_layer_dirty = NULL;
+        }
 
         g_object_unref(self->icon_render);
         g_object_unref(self->pl);
@@ -2540,8 +4373,7 @@ static void fm_desktop_destroy(GtkObject *object)
         if(self->transition_worker_handler_id)
             g_source_remove(self->transition_worker_handler_id);
 
-        if(self->idle_layout)
-            g_source_remove(self->idle_layout);
+        cancel_layout(self);
 
         g_signal_handlers_disconnect_by_func(self->dnd_src, on_dnd_src_data_get, self);
         g_object_unref(self->dnd_src);
@@ -2614,6 +4446,9 @@ static GObject* fm_desktop_constructor(GType type, guint n_construct_properties,
     pango_layout_set_wrap(self->pl, PANGO_WRAP_WORD_CHAR);
 
     self->pango_timestamp = 1;
+    self->tile_timestamp = 1;
+    ref_label_atlas(gtk_widget_get_screen((GtkWidget*)self));
+    self->layout_start_row = G_MAXINT;
 
     root = gdk_screen_get_root_window(screen);
     gdk_window_set_events(root, gdk_window_get_events(root)|GDK_PROPERTY_CHANGE_MASK);
@@ -2645,6 +4480,12 @@ static GObject* fm_desktop_constructor(GType type, guint n_construct_properties,
 
     gtk_window_group_add_window(win_group, GTK_WINDOW(self));
 
+    self->fixed_rects = g_array_new(FALSE, FALSE, sizeof(GdkRectangle));
+    self->fixed_rect_items = g_ptr_array_new();
+    self->fixed_rect_hits = g_array_new(FALSE, FALSE, sizeof(guint32));
+    self->items_index = spatial_grid_new(app_config->desktop_icon_size, app_config->desktop_icon_size);
+    self->items_geometry = item_geometry_new();
+
     connect_model(self);
     load_items(self);
 
@@ -2657,9 +4498,12 @@ static GObject* fm_desktop_constructor(GType type, guint n_construct_properties,
     g_signal_connect(app_config, "changed::arrange_icons_rtl", G_CALLBACK(on_arrange_icons_rtl_changed), self);
     g_signal_connect(app_config, "changed::arrange_icons_btt", G_CALLBACK(on_arrange_icons_btt_changed), self);
     g_signal_connect(app_config, "changed::arrange_icons_in_rows", G_CALLBACK(on_arrange_icons_in_rows_changed), self);
+    g_signal_connect(app_config, "changed::hide_overflow_icons", G_CALLBACK(on_hide_overflow_icons_changed), self);
     g_signal_connect(app_config, "changed::desktop_font", G_CALLBACK(on_desktop_font_changed), self);
     g_signal_connect(app_config, "changed::desktop_text", G_CALLBACK(on_desktop_text_changed), self);
+    g_signal_connect(app_config, "changed::desktop_shadow_style", G_CALLBACK(on_desktop_shadow_style_changed), self);
     g_signal_connect(app_config, "changed::overlap_state", G_CALLBACK(on_overlap_state_changed), self);
+    g_signal_connect(app_config, "changed::label_cache_size", G_CALLBACK(on_label_cache_size_changed), self);
 
     g_signal_connect(gtk_icon_theme_get_default(), "changed", G_CALLBACK(on_icon_theme_changed), self);
 
@@ -26,6 +26,10 @@
 #include <gtk/gtk.h>
 #include <libsmfm-gtk/fm-gtk.h>
 
+#include "spatial-grid.h"
+#include "item-geometry.h"
+#include "text-measure-pool.h"
+
 G_BEGIN_DECLS
 
 #define FM_TYPE_DESKTOP             (fm_desktop_get_type())
@@ -41,6 +45,7 @@ G_BEGIN_DECLS
 typedef struct _FmDesktop           FmDesktop;
 typedef struct _FmDesktopClass      FmDesktopClass;
 typedef struct _FmDesktopItem       FmDesktopItem;
+typedef struct _FmDesktopLayoutPass FmDesktopLayoutPass;
 
 struct _FmDesktop
 {
@@ -49,6 +54,12 @@ struct _FmDesktop
     PangoLayout* pl;
     FmCellRendererPixbuf* icon_render;
     GList* fixed_items;
+    GArray* fixed_rects; /* rects of fixed_items, packed for rect_batch_intersect() */
+    GPtrArray* fixed_rect_items; /* the item of each of fixed_rects */
+    GArray* fixed_rect_hits; /* mask of the last test of fixed_rects */
+    SpatialGrid* items_index; /* painted areas of all visible items, for hit tests */
+    ItemGeometry* items_geometry; /* rects of all items, in the order of the rows */
+    guint items_geometry_stale; /* the first row whose slot and z may be out of date */
     guint xpad;
     guint ypad;
     guint spacing;
@@ -59,6 +70,11 @@ struct _FmDesktop
     guint pango_text_h;
     guint pango_text_w;
     guint pango_timestamp;
+    guint tile_timestamp; /* bumped when all item tiles have to be rendered again */
+    const char* text_font_key; /* text extents cache key of the current font */
+    guint text_font_key_timestamp;
+    TextMeasureRequest* label_request; /* labels being measured in background */
+    guint label_request_timestamp;
     guint cell_w;
     guint cell_h;
     GdkRectangle working_area;
@@ -78,7 +94,22 @@ struct _FmDesktop
     gboolean rubber_banding : 1;
     gboolean button_pressed : 1;
     gboolean dragging : 1;
+    gboolean layout_full : 1; /* the queued layout should measure and place all items */
+    gboolean layout_snapshot_checked : 1;
+    gboolean icon_layer_invalid : 1; /* icon_layer has to be painted again as a whole */
     guint idle_layout;
+    gint layout_start_row; /* first row for the queued partial layout */
+    FmDesktopLayoutPass* layout_pass; /* the layout in progress */
+    guint idle_warm_up;
+    gint warm_up_row; /* next row to render the labels of */
+    cairo_surface_t* icon_layer; /* all items composited off screen */
+    GArray* icon_layer_dirty; /* GdkRectangle areas of icon_layer to paint again */
+#if GTK_CHECK_VERSION(3, 0, 0)
+    cairo_region_t* damage; /* to be invalidated on the next frame */
+#else
+    GdkRegion* damage;
+#endif
+    guint damage_flush_handler;
     FmDndSrc* dnd_src;
     FmDndDest* dnd_dest;
     guint single_click_timeout_handler;
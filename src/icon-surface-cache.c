@@ -0,0 +1,214 @@
+/*
+ *      icon-surface-cache.c
+ *
+ *      Copyright (c) 2026 Vadim Ushakov
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "icon-surface-cache.h"
+
+typedef struct _icon_surface_variant
+{
+    guint variant;
+    int width; /* the size it is drawn at */
+    int height;
+    cairo_surface_t * surface;
+} icon_surface_variant_t;
+
+typedef struct _icon_surface_entry
+{
+    cairo_surface_t * surface; /* the pixbuf as is, created on demand */
+    GSList * variants;         /* icon_surface_variant_t */
+} icon_surface_entry_t;
+
+static GHashTable * entries = NULL; /* GdkPixbuf -> icon_surface_entry_t */
+
+/* x * a / 255, rounded */
+static inline guint32 _premultiply(guint32 x, guint32 a)
+{
+    guint32 t = x * a + 0x80;
+    return ((t >> 8) + t) >> 8;
+}
+
+static cairo_surface_t * _surface_from_pixbuf(GdkPixbuf * pixbuf)
+{
+    int width = gdk_pixbuf_get_width(pixbuf);
+    int height = gdk_pixbuf_get_height(pixbuf);
+    int n_channels = gdk_pixbuf_get_n_channels(pixbuf);
+    int src_stride = gdk_pixbuf_get_rowstride(pixbuf);
+    const guchar * src = gdk_pixbuf_get_pixels(pixbuf);
+    gboolean has_alpha = gdk_pixbuf_get_has_alpha(pixbuf);
+    cairo_surface_t * surface;
+    guchar * dst;
+    int dst_stride;
+    int x, y;
+
+    surface = cairo_image_surface_create(has_alpha ? CAIRO_FORMAT_ARGB32 : CAIRO_FORMAT_RGB24,
+                                         width, height);
+    if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS)
+        return surface;
+
+    cairo_surface_flush(surface);
+    dst = cairo_image_surface_get_data(surface);
+    dst_stride = cairo_image_surface_get_stride(surface);
+
+    for (y = 0; y < height; y++)
+    {
+        const guchar * s = src + y * src_stride;
+        guint32 * d = (guint32 *) (dst + y * dst_stride);
+        if (has_alpha)
+        {
+            for (x = 0; x < width; x++, s += n_channels)
+            {
+                guint32 a = s[3];
+                if (a == 0)
+                    d[x] = 0;
+                else if (a == 0xFF)
+                    d[x] = 0xFF000000 | (s[0] << 16) | (s[1] << 8) | s[2];
+                else
+                    d[x] = (a << 24)
+                         | (_premultiply(s[0], a) << 16)
+                         | (_premultiply(s[1], a) << 8)
+                         | _premultiply(s[2], a);
+            }
+        }
+        else
+        {
+            for (x = 0; x < width; x++, s += n_channels)
+                d[x] = 0xFF000000 | (s[0] << 16) | (s[1] << 8) | s[2];
+        }
+    }
+
+    cairo_surface_mark_dirty(surface);
+    return surface;
+}
+
+static void _free_variants(icon_surface_entry_t * entry)
+{
+    GSList * l;
+    for (l = entry->variants; l; l = l->next)
+    {
+        icon_surface_variant_t * v = (icon_surface_variant_t *) l->data;
+        cairo_surface_destroy(v->surface);
+        g_slice_free(icon_surface_variant_t, v);
+    }
+    g_slist_free(entry->variants);
+    entry->variants = NULL;
+}
+
+static void _free_entry(gpointer data)
+{
+    icon_surface_entry_t * entry = (icon_surface_entry_t *) data;
+    if (entry->surface)
+        cairo_surface_destroy(entry->surface);
+    _free_variants(entry);
+    g_slice_free(icon_surface_entry_t, entry);
+}
+
+static void _on_pixbuf_finalized(gpointer data, GObject * pixbuf)
+{
+    g_hash_table_remove(entries, pixbuf);
+}
+
+static icon_surface_entry_t * _get_entry(GdkPixbuf * pixbuf)
+{
+    icon_surface_entry_t * entry;
+
+    if (G_UNLIKELY(!entries))
+        entries = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, _free_entry);
+
+    entry = g_hash_table_lookup(entries, pixbuf);
+    if (!entry)
+    {
+        entry = g_slice_new0(icon_surface_entry_t);
+        g_hash_table_insert(entries, pixbuf, entry);
+        g_object_weak_ref(G_OBJECT(pixbuf), _on_pixbuf_finalized, NULL);
+    }
+    return entry;
+}
+
+cairo_surface_t * icon_surface_cache_lookup(GdkPixbuf * pixbuf)
+{
+    icon_surface_entry_t * entry = _get_entry(pixbuf);
+
+    if (!entry->surface)
+        entry->surface = _surface_from_pixbuf(pixbuf);
+
+    return cairo_surface_reference(entry->surface);
+}
+
+cairo_surface_t * icon_surface_cache_lookup_variant(GdkPixbuf * pixbuf, guint variant,
+    int width, int height)
+{
+    icon_surface_entry_t * entry;
+    GSList * l;
+
+    if (!entries || !(entry = g_hash_table_lookup(entries, pixbuf)))
+        return NULL;
+
+    for (l = entry->variants; l; l = l->next)
+    {
+        icon_surface_variant_t * v = (icon_surface_variant_t *) l->data;
+        if (v->variant == variant && v->width == width && v->height == height)
+            return cairo_surface_reference(v->surface);
+    }
+    return NULL;
+}
+
+void icon_surface_cache_insert_variant(GdkPixbuf * pixbuf, guint variant,
+    int width, int height, cairo_surface_t * surface)
+{
+    icon_surface_entry_t * entry = _get_entry(pixbuf);
+    icon_surface_variant_t * v;
+    GSList * l;
+
+    for (l = entry->variants; l; l = l->next)
+    {
+        v = (icon_surface_variant_t *) l->data;
+        if (v->variant == variant && v->width == width && v->height == height)
+        {
+            cairo_surface_reference(surface);
+            cairo_surface_destroy(v->surface);
+            v->surface = surface;
+            return;
+        }
+    }
+
+    v = g_slice_new(icon_surface_variant_t);
+    v->variant = variant;
+    v->width = width;
+    v->height = height;
+    v->surface = cairo_surface_reference(surface);
+    entry->variants = g_slist_prepend(entry->variants, v);
+}
+
+void icon_surface_cache_clear_variants(void)
+{
+    GHashTableIter it;
+    gpointer entry;
+
+    if (!entries)
+        return;
+
+    g_hash_table_iter_init(&it, entries);
+    while (g_hash_table_iter_next(&it, NULL, &entry))
+        _free_variants((icon_surface_entry_t *) entry);
+}
@@ -0,0 +1,63 @@
+/*
+ *      icon-surface-cache.h
+ *
+ *      Copyright (c) 2026 Vadim Ushakov
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+
+#ifndef __ICON_SURFACE_CACHE_H__
+#define __ICON_SURFACE_CACHE_H__
+
+#include <cairo.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+G_BEGIN_DECLS
+
+/*
+    The icon surface cache keeps one premultiplied cairo image surface per
+    icon pixbuf, shared by all desktops of the process.
+
+    The folder model hands out the same pixbuf for every file with the same
+    icon at the same size, so the pixbuf itself identifies both the icon
+    and its size. A surface is dropped from the cache together with its
+    pixbuf, e.g. after the icon theme or the icon size has changed.
+
+    Besides the plain surface, every pixbuf may have variants: the icon
+    as drawn in some other state, e.g. tinted as selected or with an
+    emblem on it. The meaning of the variant numbers is up to the caller,
+    and since the variants depend on the widget style, the caller has to
+    clear them when the style changes.
+*/
+
+/* Returns a new reference to the surface of pixbuf. */
+cairo_surface_t * icon_surface_cache_lookup(GdkPixbuf * pixbuf);
+
+/* Returns a new reference to the variant of pixbuf drawn into a
+   width x height area, or NULL if it is not in the cache. */
+cairo_surface_t * icon_surface_cache_lookup_variant(GdkPixbuf * pixbuf, guint variant,
+    int width, int height);
+
+/* Stores the variant of pixbuf, replacing the one already stored. */
+void icon_surface_cache_insert_variant(GdkPixbuf * pixbuf, guint variant,
+    int width, int height, cairo_surface_t * surface);
+
+void icon_surface_cache_clear_variants(void);
+
+G_END_DECLS
+
+#endif /* __ICON_SURFACE_CACHE_H__ */
@@ -0,0 +1,98 @@
+/*
+ *      item-geometry.c
+ *
+ *      Copyright (c) 2026 Vadim Ushakov
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "item-geometry.h"
+#include "rect-batch.h"
+
+ItemGeometry * item_geometry_new(void)
+{
+    return g_slice_new0(ItemGeometry);
+}
+
+void item_geometry_free(ItemGeometry * geometry)
+{
+    if (!geometry)
+        return;
+    g_free(geometry->icon_rects);
+    g_free(geometry->text_rects);
+    g_free(geometry->positions);
+    g_free(geometry->flags);
+    g_free(geometry->items);
+    g_free(geometry->icon_hits);
+    g_free(geometry->text_hits);
+    g_slice_free(ItemGeometry, geometry);
+}
+
+static void _reserve(ItemGeometry * geometry, guint n_items)
+{
+    guint size;
+
+    if (n_items <= geometry->size)
+        return;
+
+    size = MAX(geometry->size * 2, 64);
+    while (size < n_items)
+        size *= 2;
+
+    geometry->icon_rects = g_renew(GdkRectangle, geometry->icon_rects, size);
+    geometry->text_rects = g_renew(GdkRectangle, geometry->text_rects, size);
+    geometry->positions = g_renew(GdkPoint, geometry->positions, size);
+    geometry->flags = g_renew(guint8, geometry->flags, size);
+    geometry->items = g_renew(gpointer, geometry->items, size);
+    geometry->icon_hits = g_renew(guint32, geometry->icon_hits, RECT_BATCH_MASK_WORDS(size));
+    geometry->text_hits = g_renew(guint32, geometry->text_hits, RECT_BATCH_MASK_WORDS(size));
+    geometry->size = size;
+}
+
+void item_geometry_resize(ItemGeometry * geometry, guint n_items)
+{
+    static const GdkRectangle empty = {0, 0, 0, 0};
+    guint i;
+
+    _reserve(geometry, n_items);
+    for (i = geometry->n_items; i < n_items; i++)
+    {
+        geometry->icon_rects[i] = empty;
+        geometry->text_rects[i] = empty;
+        geometry->positions[i].x = geometry->positions[i].y = 0;
+        geometry->flags[i] = ITEM_GEOMETRY_VIRTUAL;
+        geometry->items[i] = NULL;
+    }
+    geometry->n_items = n_items;
+}
+
+void item_geometry_set(ItemGeometry * geometry, guint index, gpointer item,
+    const GdkRectangle * icon_rect, const GdkRectangle * text_rect,
+    int x, int y, guint8 flags)
+{
+    if (index >= geometry->n_items)
+        return;
+    geometry->items[index] = item;
+    geometry->icon_rects[index] = *icon_rect;
+    geometry->text_rects[index] = *text_rect;
+    geometry->positions[index].x = x;
+    geometry->positions[index].y = y;
+    geometry->flags[index] = flags;
+}
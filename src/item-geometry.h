@@ -0,0 +1,74 @@
+/*
+ *      item-geometry.h
+ *
+ *      Copyright (c) 2026 Vadim Ushakov
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+
+#ifndef __ITEM_GEOMETRY_H__
+#define __ITEM_GEOMETRY_H__
+
+#include <gdk/gdk.h>
+
+G_BEGIN_DECLS
+
+/*
+    ItemGeometry mirrors the geometry of the items of a list model in
+    parallel arrays, one slot per row, so the scans over all the items
+    read a few dense arrays instead of walking the model and the items.
+
+    The slots are not moved when rows are inserted, deleted or reordered.
+    The owner sets them again from the first row that has moved on, before
+    the next scan, so a burst of row changes costs a single pass.
+
+    The arrays are public and meant to be read directly. They are changed
+    only by the functions below.
+
+    icon_hits and text_hits have a bit per slot, for the masks of
+    rect_batch_intersect() over icon_rects and text_rects. They are
+    scratch space, grown with the slots, so the scans need not allocate.
+*/
+
+#define ITEM_GEOMETRY_VIRTUAL (1 << 0) /* takes no room on the screen */
+
+typedef struct _ItemGeometry
+{
+    guint n_items;
+    guint size; /* allocated slots */
+    GdkRectangle * icon_rects;
+    GdkRectangle * text_rects;
+    GdkPoint * positions;
+    guint8 * flags;
+    gpointer * items;
+    guint32 * icon_hits;
+    guint32 * text_hits;
+} ItemGeometry;
+
+ItemGeometry * item_geometry_new(void);
+void item_geometry_free(ItemGeometry * geometry);
+
+/* Sets the number of slots. The new ones are empty and virtual. */
+void item_geometry_resize(ItemGeometry * geometry, guint n_items);
+
+void item_geometry_set(ItemGeometry * geometry, guint index, gpointer item,
+    const GdkRectangle * icon_rect, const GdkRectangle * text_rect,
+    int x, int y, guint8 flags);
+
+G_END_DECLS
+
+#endif /* __ITEM_GEOMETRY_H__ */
@@ -0,0 +1,407 @@
+/*
+ *      label-atlas.c
+ *
+ *      Copyright (c) 2026 Vadim Ushakov
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+
+#include "label-atlas.h"
+
+/* empty room between the entries, so a mask painted at a fractional
+   offset does not pick up the edge of its neighbour */
+#define GUTTER 1
+
+/* shelf heights are rounded up to this, so similar labels share shelves */
+#define SHELF_ROUNDING 4
+
+typedef struct _LabelAtlasPage LabelAtlasPage;
+
+typedef struct _shelf
+{
+    int y;
+    int height;
+    int used;
+} shelf_t;
+
+struct _LabelAtlasEntry
+{
+    LabelAtlasPage * page;
+    int x;
+    int y;
+    int width;
+    int height;
+    LabelAtlasEntry ** owner;
+    GList link; /* in page->entries */
+};
+
+struct _LabelAtlasPage
+{
+    LabelAtlas * atlas;
+    cairo_surface_t * surface;
+    GArray * shelves;
+    int top; /* where the next shelf starts */
+    gint64 area; /* taken by live entries, gutters included */
+    guint64 last_used;
+    GQueue entries;
+    GList link; /* in atlas->pages */
+};
+
+struct _LabelAtlas
+{
+    int page_size;
+    guint max_pages;
+    guint64 clock;
+    GQueue pages;
+    LabelAtlasStats stats;
+};
+
+static inline gsize _page_bytes(LabelAtlas * atlas)
+{
+    /* the pages are alpha only, one byte per pixel */
+    return (gsize) atlas->page_size * atlas->page_size;
+}
+
+LabelAtlas * label_atlas_new(int page_size, gsize budget)
+{
+    LabelAtlas * atlas = g_slice_new0(LabelAtlas);
+    atlas->page_size = MAX(page_size, 64);
+    g_queue_init(&atlas->pages);
+    label_atlas_set_budget(atlas, budget);
+    return atlas;
+}
+
+static void _entry_destroy(LabelAtlasEntry * entry)
+{
+    if (entry->owner && *entry->owner == entry)
+        *entry->owner = NULL;
+    g_slice_free(LabelAtlasEntry, entry);
+}
+
+/* drops all entries of the page, keeping its surface */
+static void _page_clear(LabelAtlasPage * page)
+{
+    GList * l;
+    while ((l = g_queue_pop_head_link(&page->entries)) != NULL)
+    {
+        page->atlas->stats.evictions++;
+        _entry_destroy((LabelAtlasEntry *) l->data);
+    }
+    g_array_set_size(page->shelves, 0);
+    page->top = 0;
+    page->area = 0;
+}
+
+static void _page_free(LabelAtlasPage * page)
+{
+    _page_clear(page);
+    g_array_free(page->shelves, TRUE);
+    cairo_surface_destroy(page->surface);
+    page->atlas->stats.bytes -= _page_bytes(page->atlas);
+    g_slice_free(LabelAtlasPage, page);
+}
+
+void label_atlas_free(LabelAtlas * atlas)
+{
+    GList * l;
+
+    if (!atlas)
+        return;
+
+    while ((l = g_queue_pop_head_link(&atlas->pages)) != NULL)
+        _page_free((LabelAtlasPage *) l->data);
+    g_slice_free(LabelAtlas, atlas);
+}
+
+static LabelAtlasPage * _least_recently_used_page(LabelAtlas * atlas)
+{
+    LabelAtlasPage * victim = NULL;
+    GList * l;
+    for (l = atlas->pages.head; l; l = l->next)
+    {
+        LabelAtlasPage * page = (LabelAtlasPage *) l->data;
+        if (!victim || page->last_used < victim->last_used)
+            victim = page;
+    }
+    return victim;
+}
+
+void label_atlas_set_budget(LabelAtlas * atlas, gsize budget)
+{
+    atlas->max_pages = (guint) MAX(budget / _page_bytes(atlas), 1);
+    atlas->stats.budget = (gsize) atlas->max_pages * _page_bytes(atlas);
+
+    while (atlas->pages.length > atlas->max_pages)
+    {
+        LabelAtlasPage * victim = _least_recently_used_page(atlas);
+        g_queue_unlink(&atlas->pages, &victim->link);
+        _page_free(victim);
+    }
+}
+
+void label_atlas_get_stats(LabelAtlas * atlas, LabelAtlasStats * stats)
+{
+    *stats = atlas->stats;
+}
+
+static LabelAtlasPage * _page_new(LabelAtlas * atlas, cairo_surface_t * target)
+{
+    LabelAtlasPage * page;
+    cairo_surface_t * surface = cairo_surface_create_similar(target, CAIRO_CONTENT_ALPHA,
+        atlas->page_size, atlas->page_size);
+
+    if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS)
+    {
+        cairo_surface_destroy(surface);
+        return NULL;
+    }
+
+    page = g_slice_new0(LabelAtlasPage);
+    page->atlas = atlas;
+    page->surface = surface;
+    page->shelves = g_array_new(FALSE, FALSE, sizeof(shelf_t));
+    g_queue_init(&page->entries);
+    page->link.data = page;
+    g_queue_push_tail_link(&atlas->pages, &page->link);
+    atlas->stats.bytes += _page_bytes(atlas);
+    return page;
+}
+
+/* Finds room for a width x height area (gutter included) on the page. */
+static gboolean _page_alloc(LabelAtlasPage * page, int width, int height, int * x, int * y)
+{
+    int page_size = page->atlas->page_size;
+    int shelf_height = (height + SHELF_ROUNDING - 1) / SHELF_ROUNDING * SHELF_ROUNDING;
+    shelf_t * best = NULL;
+    guint i;
+
+    /* the lowest shelf that fits, unless it wastes too much height */
+    for (i = 0; i < page->shelves->len; i++)
+    {
+        shelf_t * shelf = &g_array_index(page->shelves, shelf_t, i);
+        if (shelf->height < height || shelf->height > shelf_height * 3 / 2)
+            continue;
+        if (page_size - shelf->used < width)
+            continue;
+        if (!best || shelf->height < best->height)
+            best = shelf;
+    }
+
+    if (!best)
+    {
+        shelf_t shelf;
+        if (page->top + height > page_size)
+            return FALSE;
+        shelf.y = page->top;
+        shelf.height = MIN(shelf_height, page_size - page->top);
+        shelf.used = 0;
+        page->top += shelf.height;
+        g_array_append_val(page->shelves, shelf);
+        best = &g_array_index(page->shelves, shelf_t, page->shelves->len - 1);
+    }
+
+    *x = best->used;
+    *y = best->y;
+    best->used += width;
+    page->area += (gint64) width * height;
+    return TRUE;
+}
+
+static gint _compare_entry_height(gconstpointer a, gconstpointer b)
+{
+    return ((const LabelAtlasEntry *) b)->height - ((const LabelAtlasEntry *) a)->height;
+}
+
+/* Packs the live entries of the page again, tallest first, so the space
+   of the freed ones can be used. */
+static void _page_compact(LabelAtlasPage * page)
+{
+    cairo_surface_t * old_surface = page->surface;
+    cairo_surface_t * surface = cairo_surface_create_similar(old_surface, CAIRO_CONTENT_ALPHA,
+        page->atlas->page_size, page->atlas->page_size);
+    GList * entries;
+    GList * l;
+    cairo_t * cr;
+
+    if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS)
+    {
+        cairo_surface_destroy(surface);
+        return;
+    }
+
+    entries = page->entries.head;
+    g_queue_init(&page->entries);
+    g_array_set_size(page->shelves, 0);
+    page->top = 0;
+    page->area = 0;
+    entries = g_list_sort(entries, _compare_entry_height);
+
+    cr = cairo_create(surface);
+    cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+    for (l = entries; l; )
+    {
+        LabelAtlasEntry * entry = (LabelAtlasEntry *) l->data;
+        GList * next = l->next;
+        int x, y;
+
+        l->prev = l->next = NULL;
+        if (_page_alloc(page, entry->width + GUTTER, entry->height + GUTTER, &x, &y))
+        {
+            cairo_set_source_surface(cr, old_surface, x - entry->x, y - entry->y);
+            cairo_rectangle(cr, x, y, entry->width, entry->height);
+            cairo_fill(cr);
+            entry->x = x;
+            entry->y = y;
+            g_queue_push_tail_link(&page->entries, l);
+        }
+        else
+        {
+            page->atlas->stats.evictions++;
+            _entry_destroy(entry);
+        }
+        l = next;
+    }
+    cairo_destroy(cr);
+
+    page->surface = surface;
+    cairo_surface_destroy(old_surface);
+}
+
+static LabelAtlasEntry * _entry_new(LabelAtlasPage * page, int x, int y,
+    int width, int height, LabelAtlasEntry ** owner)
+{
+    LabelAtlasEntry * entry = g_slice_new0(LabelAtlasEntry);
+    entry->page = page;
+    entry->x = x;
+    entry->y = y;
+    entry->width = width;
+    entry->height = height;
+    entry->owner = owner;
+    entry->link.data = entry;
+    g_queue_push_tail_link(&page->entries, &entry->link);
+    page->last_used = ++page->atlas->clock;
+    *owner = entry;
+    return entry;
+}
+
+LabelAtlasEntry * label_atlas_alloc(LabelAtlas * atlas, cairo_surface_t * target,
+    int width, int height, LabelAtlasEntry ** owner)
+{
+    int w = width + GUTTER;
+    int h = height + GUTTER;
+    LabelAtlasPage * page;
+    LabelAtlasPage * victim = NULL;
+    gint64 most_waste = 0;
+    GList * l;
+    int x, y;
+
+    *owner = NULL;
+    atlas->stats.misses++;
+    if (width <= 0 || height <= 0 || w > atlas->page_size || h > atlas->page_size)
+        return NULL;
+
+    for (l = atlas->pages.head; l; l = l->next)
+    {
+        page = (LabelAtlasPage *) l->data;
+        if (_page_alloc(page, w, h, &x, &y))
+            return _entry_new(page, x, y, width, height, owner);
+    }
+
+    if (atlas->pages.length < atlas->max_pages)
+    {
+        page = _page_new(atlas, target);
+        if (page && _page_alloc(page, w, h, &x, &y))
+            return _entry_new(page, x, y, width, height, owner);
+        return NULL;
+    }
+
+    /* compact the page that has the most room in the holes of its shelves */
+    for (l = atlas->pages.head; l; l = l->next)
+    {
+        gint64 waste;
+        page = (LabelAtlasPage *) l->data;
+        waste = (gint64) page->top * atlas->page_size - page->area;
+        if (waste > most_waste)
+        {
+            most_waste = waste;
+            victim = page;
+        }
+    }
+    if (victim && most_waste >= (gint64) w * h * 4)
+    {
+        _page_compact(victim);
+        if (_page_alloc(victim, w, h, &x, &y))
+            return _entry_new(victim, x, y, width, height, owner);
+    }
+
+    /* evict the least recently painted page */
+    victim = _least_recently_used_page(atlas);
+    _page_clear(victim);
+    if (_page_alloc(victim, w, h, &x, &y))
+        return _entry_new(victim, x, y, width, height, owner);
+    return NULL;
+}
+
+void label_atlas_entry_free(LabelAtlasEntry * entry)
+{
+    LabelAtlasPage * page;
+
+    if (!entry)
+        return;
+
+    page = entry->page;
+    g_queue_unlink(&page->entries, &entry->link);
+    page->area -= (gint64) (entry->width + GUTTER) * (entry->height + GUTTER);
+    if (page->entries.length == 0)
+    {
+        /* nothing left, the page can be filled from scratch */
+        g_array_set_size(page->shelves, 0);
+        page->top = 0;
+        page->area = 0;
+    }
+    _entry_destroy(entry);
+}
+
+cairo_t * label_atlas_entry_begin(LabelAtlasEntry * entry)
+{
+    cairo_t * cr = cairo_create(entry->page->surface);
+    cairo_rectangle(cr, entry->x, entry->y, entry->width, entry->height);
+    cairo_clip(cr);
+    cairo_set_operator(cr, CAIRO_OPERATOR_CLEAR);
+    cairo_paint(cr);
+    cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+    cairo_translate(cr, entry->x, entry->y);
+    return cr;
+}
+
+void label_atlas_entry_mask(LabelAtlasEntry * entry, cairo_t * cr, double x, double y)
+{
+    LabelAtlasPage * page = entry->page;
+
+    page->last_used = ++page->atlas->clock;
+    page->atlas->stats.hits++;
+
+    cairo_save(cr);
+    cairo_rectangle(cr, x, y, entry->width, entry->height);
+    cairo_clip(cr);
+    cairo_mask_surface(cr, page->surface, x - entry->x, y - entry->y);
+    cairo_restore(cr);
+}
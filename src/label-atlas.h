@@ -0,0 +1,88 @@
+/*
+ *      label-atlas.h
+ *
+ *      Copyright (c) 2026 Vadim Ushakov
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+
+#ifndef __LABEL_ATLAS_H__
+#define __LABEL_ATLAS_H__
+
+#include <cairo.h>
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+    LabelAtlas packs the rendered label masks into a few large alpha
+    surfaces instead of one small surface per label, which on X11 means
+    a few server-side pixmaps instead of thousands.
+
+    Every page is filled with shelves: rows of entries of about the same
+    height. Space of freed entries is taken back by compacting the page
+    that wastes the most, and once the page limit is reached the least
+    recently painted page is emptied to make room.
+
+    The owner pointer given to label_atlas_alloc() is set to NULL when its
+    entry goes away, so the owner knows it has to render the label again.
+
+    The number of pages is bounded by a memory budget given in bytes.
+*/
+
+typedef struct _LabelAtlas LabelAtlas;
+typedef struct _LabelAtlasEntry LabelAtlasEntry;
+
+typedef struct _LabelAtlasStats
+{
+    guint64 hits;      /* entries painted */
+    guint64 misses;    /* entries allocated, i.e. labels rendered */
+    guint64 evictions; /* entries dropped to make room */
+    gsize bytes;       /* taken by the pages */
+    gsize budget;
+} LabelAtlasStats;
+
+/* The budget is rounded down to whole pages, but holds one page at least. */
+LabelAtlas * label_atlas_new(int page_size, gsize budget);
+
+/* Frees all entries and sets their owners to NULL. */
+void label_atlas_free(LabelAtlas * atlas);
+
+/* Evicts the least recently painted pages, if they exceed the new budget. */
+void label_atlas_set_budget(LabelAtlas * atlas, gsize budget);
+
+void label_atlas_get_stats(LabelAtlas * atlas, LabelAtlasStats * stats);
+
+/* Allocates a width x height area and stores the entry in *owner.
+   The pages are created similar to target.
+   Returns NULL if the area is larger than a page. */
+LabelAtlasEntry * label_atlas_alloc(LabelAtlas * atlas, cairo_surface_t * target,
+    int width, int height, LabelAtlasEntry ** owner);
+
+void label_atlas_entry_free(LabelAtlasEntry * entry);
+
+/* Returns a context for drawing the entry's mask. Its origin is the
+   top-left corner of the entry, it is clipped to the entry, and the
+   entry is cleared. Destroy it when done. */
+cairo_t * label_atlas_entry_begin(LabelAtlasEntry * entry);
+
+/* Paints the current source of cr through the entry's mask at x, y. */
+void label_atlas_entry_mask(LabelAtlasEntry * entry, cairo_t * cr, double x, double y);
+
+G_END_DECLS
+
+#endif /* __LABEL_ATLAS_H__ */
@@ -216,6 +216,7 @@ void fm_desktop_preference(GtkAction* act, GtkWindow* parent)
 
         INIT_COLOR(builder, FmAppConfig, desktop_fg, "desktop_text");
         INIT_COLOR(builder, FmAppConfig, desktop_shadow, "desktop_text");
+        INIT_COMBO(builder, FmAppConfig, desktop_shadow_style, "desktop_shadow_style");
 
         INIT_BOOL(builder, FmAppConfig, show_wm_menu, NULL);
 
@@ -223,6 +224,7 @@ void fm_desktop_preference(GtkAction* act, GtkWindow* parent)
         INIT_COMBO(builder, FmAppConfig, arrange_icons_btt, "arrange_icons_btt");
         INIT_COMBO(builder, FmAppConfig, arrange_icons_in_rows, "arrange_icons_in_rows");
         INIT_INT(builder, FmAppConfig, desktop_icon_size, "desktop_icon_size");
+        INIT_BOOL(builder, FmAppConfig, hide_overflow_icons, "hide_overflow_icons");
 
         item = (GtkWidget*)gtk_builder_get_object(builder, "desktop_font");
         if(app_config->desktop_font)
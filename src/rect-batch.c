@@ -0,0 +1,184 @@
+/*
+ *      rect-batch.c
+ *
+ *      Copyright (c) 2026 Vadim Ushakov
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include "rect-batch.h"
+#include "cpu-features.h"
+
+#ifdef CPU_FEATURES_X86
+#include <immintrin.h>
+#endif
+
+/*
+    Rect r intersects the query rect from x1, y1 to x2, y2 if
+        r.x < x2 && x1 < r.x + r.width && r.y < y2 && y1 < r.y + r.height
+    and r is not empty.
+*/
+
+/* Tests rects[from..n) and sets their bits, which have to be clear. */
+typedef void (*RectBatchFunc)(const GdkRectangle * rects, guint from, guint n,
+    int x1, int y1, int x2, int y2, guint32 * mask);
+
+static void _test_scalar(const GdkRectangle * rects, guint from, guint n,
+    int x1, int y1, int x2, int y2, guint32 * mask)
+{
+    guint i;
+    for (i = from; i < n; i++)
+    {
+        const GdkRectangle * r = &rects[i];
+        if (r->width > 0 && r->height > 0
+        &&  r->x < x2 && x1 < r->x + r->width
+        &&  r->y < y2 && y1 < r->y + r->height)
+            mask[i / 32] |= 1u << (i % 32);
+    }
+}
+
+#ifdef CPU_FEATURES_X86
+
+/* 4 rects per step */
+__attribute__((target("sse2")))
+static void _test_sse2(const GdkRectangle * rects, guint from, guint n,
+    int x1, int y1, int x2, int y2, guint32 * mask)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i vx1 = _mm_set1_epi32(x1);
+    const __m128i vy1 = _mm_set1_epi32(y1);
+    const __m128i vx2 = _mm_set1_epi32(x2);
+    const __m128i vy2 = _mm_set1_epi32(y2);
+    guint i;
+
+    /* the mask of a step must not straddle two words */
+    for (i = from; i % 4 != 0 && i < n; i++)
+        _test_scalar(rects, i, i + 1, x1, y1, x2, y2, mask);
+
+    for (; i + 4 <= n; i += 4)
+    {
+        /* four x, y, width, height rows to x, y, width and height columns */
+        __m128i r0 = _mm_loadu_si128((const __m128i *) &rects[i]);
+        __m128i r1 = _mm_loadu_si128((const __m128i *) &rects[i + 1]);
+        __m128i r2 = _mm_loadu_si128((const __m128i *) &rects[i + 2]);
+        __m128i r3 = _mm_loadu_si128((const __m128i *) &rects[i + 3]);
+        __m128i t0 = _mm_unpacklo_epi32(r0, r1); /* x0 x1 y0 y1 */
+        __m128i t1 = _mm_unpacklo_epi32(r2, r3); /* x2 x3 y2 y3 */
+        __m128i t2 = _mm_unpackhi_epi32(r0, r1); /* w0 w1 h0 h1 */
+        __m128i t3 = _mm_unpackhi_epi32(r2, r3); /* w2 w3 h2 h3 */
+        __m128i x = _mm_unpacklo_epi64(t0, t1);
+        __m128i y = _mm_unpackhi_epi64(t0, t1);
+        __m128i w = _mm_unpacklo_epi64(t2, t3);
+        __m128i h = _mm_unpackhi_epi64(t2, t3);
+        __m128i hit;
+
+        hit = _mm_and_si128(_mm_cmpgt_epi32(w, zero), _mm_cmpgt_epi32(h, zero));
+        hit = _mm_and_si128(hit, _mm_cmplt_epi32(x, vx2));
+        hit = _mm_and_si128(hit, _mm_cmpgt_epi32(_mm_add_epi32(x, w), vx1));
+        hit = _mm_and_si128(hit, _mm_cmplt_epi32(y, vy2));
+        hit = _mm_and_si128(hit, _mm_cmpgt_epi32(_mm_add_epi32(y, h), vy1));
+
+        mask[i / 32] |= (guint32) _mm_movemask_ps(_mm_castsi128_ps(hit)) << (i % 32);
+    }
+
+    _test_scalar(rects, i, n, x1, y1, x2, y2, mask);
+}
+
+/* 8 rects per step; unpack works within 128-bit lanes, so the columns
+   come out as rects 0 2 4 6 | 1 3 5 7 and are put in order at the end */
+__attribute__((target("avx2")))
+static void _test_avx2(const GdkRectangle * rects, guint from, guint n,
+    int x1, int y1, int x2, int y2, guint32 * mask)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i vx1 = _mm256_set1_epi32(x1);
+    const __m256i vy1 = _mm256_set1_epi32(y1);
+    const __m256i vx2 = _mm256_set1_epi32(x2);
+    const __m256i vy2 = _mm256_set1_epi32(y2);
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    guint i;
+
+    /* the mask of a step must not straddle two words */
+    for (i = from; i % 8 != 0 && i < n; i++)
+        _test_scalar(rects, i, i + 1, x1, y1, x2, y2, mask);
+
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256i r0 = _mm256_loadu_si256((const __m256i *) &rects[i]);     /* rects 0 1 */
+        __m256i r1 = _mm256_loadu_si256((const __m256i *) &rects[i + 2]); /* rects 2 3 */
+        __m256i r2 = _mm256_loadu_si256((const __m256i *) &rects[i + 4]); /* rects 4 5 */
+        __m256i r3 = _mm256_loadu_si256((const __m256i *) &rects[i + 6]); /* rects 6 7 */
+        __m256i t0 = _mm256_unpacklo_epi32(r0, r1); /* x0 x2 y0 y2 | x1 x3 y1 y3 */
+        __m256i t1 = _mm256_unpacklo_epi32(r2, r3); /* x4 x6 y4 y6 | x5 x7 y5 y7 */
+        __m256i t2 = _mm256_unpackhi_epi32(r0, r1);
+        __m256i t3 = _mm256_unpackhi_epi32(r2, r3);
+        __m256i x = _mm256_unpacklo_epi64(t0, t1);
+        __m256i y = _mm256_unpackhi_epi64(t0, t1);
+        __m256i w = _mm256_unpacklo_epi64(t2, t3);
+        __m256i h = _mm256_unpackhi_epi64(t2, t3);
+        __m256i hit;
+
+        hit = _mm256_and_si256(_mm256_cmpgt_epi32(w, zero), _mm256_cmpgt_epi32(h, zero));
+        hit = _mm256_and_si256(hit, _mm256_cmpgt_epi32(vx2, x));
+        hit = _mm256_and_si256(hit, _mm256_cmpgt_epi32(_mm256_add_epi32(x, w), vx1));
+        hit = _mm256_and_si256(hit, _mm256_cmpgt_epi32(vy2, y));
+        hit = _mm256_and_si256(hit, _mm256_cmpgt_epi32(_mm256_add_epi32(y, h), vy1));
+        hit = _mm256_permutevar8x32_epi32(hit, order);
+
+        mask[i / 32] |= (guint32) _mm256_movemask_ps(_mm256_castsi256_ps(hit)) << (i % 32);
+    }
+
+    _test_scalar(rects, i, n, x1, y1, x2, y2, mask);
+}
+
+#endif /* CPU_FEATURES_X86 */
+
+static RectBatchFunc _get_test(void)
+{
+    static RectBatchFunc func = NULL;
+
+    if (G_UNLIKELY(!func))
+    {
+        func = _test_scalar;
+#ifdef CPU_FEATURES_X86
+        CpuFeatures features = cpu_features_get();
+        /* rects go 8 at a time with AVX2 and 4 with SSE2 */
+        if (features & CPU_FEATURE_AVX2)
+            func = _test_avx2;
+        else if (features & CPU_FEATURE_SSE2)
+            func = _test_sse2;
+#endif
+    }
+
+    return func;
+}
+
+void rect_batch_intersect(const GdkRectangle * rects, guint n,
+    const GdkRectangle * rect, guint32 * mask)
+{
+    if (n == 0)
+        return;
+    memset(mask, 0, RECT_BATCH_MASK_WORDS(n) * sizeof(guint32));
+    if (rect->width <= 0 || rect->height <= 0)
+        return;
+    _get_test()(rects, 0, n, rect->x, rect->y, rect->x + rect->width, rect->y + rect->height, mask);
+}
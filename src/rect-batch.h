@@ -0,0 +1,44 @@
+/*
+ *      rect-batch.h
+ *
+ *      Copyright (c) 2026 Vadim Ushakov
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+
+#ifndef __RECT_BATCH_H__
+#define __RECT_BATCH_H__
+
+#include <gdk/gdk.h>
+
+G_BEGIN_DECLS
+
+/*
+    Tests of one rectangle against an array of rectangles, a few
+    rectangles per SIMD instruction where the CPU supports it. The result
+    is a bit mask: bit i of mask[i / 32] is set if rects[i] matches.
+*/
+
+#define RECT_BATCH_MASK_WORDS(n) (((n) + 31) / 32)
+
+/* Matches the rects that gdk_rectangle_intersect() says intersect rect. */
+void rect_batch_intersect(const GdkRectangle * rects, guint n,
+    const GdkRectangle * rect, guint32 * mask);
+
+G_END_DECLS
+
+#endif /* __RECT_BATCH_H__ */
@@ -0,0 +1,292 @@
+/*
+ *      spatial-grid.c
+ *
+ *      Copyright (c) 2026 Vadim Ushakov
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "spatial-grid.h"
+
+typedef struct _spatial_grid_entry
+{
+    gpointer data;
+    GdkRectangle rect;
+    guint stamp; /* the last query that visited this entry */
+} spatial_grid_entry_t;
+
+struct _SpatialGrid
+{
+    int cell_w;
+    int cell_h;
+    GHashTable * buckets; /* packed cell coordinates -> GPtrArray of entries */
+    GHashTable * entries; /* data -> spatial_grid_entry_t */
+    guint stamp;
+};
+
+static inline int _floor_div(int a, int b)
+{
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+/* Cells far away from each other may share a bucket. That is harmless,
+   since every candidate is tested against the query rect anyway. */
+static inline gpointer _cell_key(int cx, int cy)
+{
+    return GUINT_TO_POINTER((((guint) cx & 0xFFFF) << 16) | ((guint) cy & 0xFFFF));
+}
+
+static inline gboolean _rect_is_empty(const GdkRectangle * rect)
+{
+    return rect->width <= 0 || rect->height <= 0;
+}
+
+static void _get_cell_range(SpatialGrid * grid, const GdkRectangle * rect,
+    int * cx0, int * cy0, int * cx1, int * cy1)
+{
+    *cx0 = _floor_div(rect->x, grid->cell_w);
+    *cy0 = _floor_div(rect->y, grid->cell_h);
+    *cx1 = _floor_div(rect->x + rect->width - 1, grid->cell_w);
+    *cy1 = _floor_div(rect->y + rect->height - 1, grid->cell_h);
+}
+
+static void _link_entry(SpatialGrid * grid, spatial_grid_entry_t * entry)
+{
+    int cx0, cy0, cx1, cy1, cx, cy;
+
+    if (_rect_is_empty(&entry->rect))
+        return;
+
+    _get_cell_range(grid, &entry->rect, &cx0, &cy0, &cx1, &cy1);
+    for (cy = cy0; cy <= cy1; cy++)
+    {
+        for (cx = cx0; cx <= cx1; cx++)
+        {
+            gpointer key = _cell_key(cx, cy);
+            GPtrArray * bucket = g_hash_table_lookup(grid->buckets, key);
+            if (!bucket)
+            {
+                bucket = g_ptr_array_new();
+                g_hash_table_insert(grid->buckets, key, bucket);
+            }
+            else if (cx != cx0 || cy != cy0)
+            {
+                /* a bucket shared by two cells of the same rect */
+                guint i;
+                for (i = 0; i < bucket->len; i++)
+                    if (g_ptr_array_index(bucket, i) == entry)
+                        break;
+                if (i < bucket->len)
+                    continue;
+            }
+            g_ptr_array_add(bucket, entry);
+        }
+    }
+}
+
+static void _unlink_entry(SpatialGrid * grid, spatial_grid_entry_t * entry)
+{
+    int cx0, cy0, cx1, cy1, cx, cy;
+
+    if (_rect_is_empty(&entry->rect))
+        return;
+
+    _get_cell_range(grid, &entry->rect, &cx0, &cy0, &cx1, &cy1);
+    for (cy = cy0; cy <= cy1; cy++)
+    {
+        for (cx = cx0; cx <= cx1; cx++)
+        {
+            gpointer key = _cell_key(cx, cy);
+            GPtrArray * bucket = g_hash_table_lookup(grid->buckets, key);
+            if (!bucket)
+                continue;
+            g_ptr_array_remove_fast(bucket, entry);
+            if (bucket->len == 0)
+                g_hash_table_remove(grid->buckets, key);
+        }
+    }
+}
+
+static void _free_bucket(gpointer bucket)
+{
+    g_ptr_array_free((GPtrArray *) bucket, TRUE);
+}
+
+static void _free_entry(gpointer entry)
+{
+    g_slice_free(spatial_grid_entry_t, entry);
+}
+
+SpatialGrid * spatial_grid_new(int cell_w, int cell_h)
+{
+    SpatialGrid * grid = g_slice_new0(SpatialGrid);
+    grid->cell_w = MAX(cell_w, 1);
+    grid->cell_h = MAX(cell_h, 1);
+    grid->buckets = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, _free_bucket);
+    grid->entries = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, _free_entry);
+    return grid;
+}
+
+void spatial_grid_free(SpatialGrid * grid)
+{
+    if (!grid)
+        return;
+    g_hash_table_destroy(grid->buckets);
+    g_hash_table_destroy(grid->entries);
+    g_slice_free(SpatialGrid, grid);
+}
+
+void spatial_grid_set_cell_size(SpatialGrid * grid, int cell_w, int cell_h)
+{
+    GHashTableIter it;
+    gpointer entry;
+
+    cell_w = MAX(cell_w, 1);
+    cell_h = MAX(cell_h, 1);
+    if (grid->cell_w == cell_w && grid->cell_h == cell_h)
+        return;
+
+    g_hash_table_remove_all(grid->buckets);
+    grid->cell_w = cell_w;
+    grid->cell_h = cell_h;
+
+    g_hash_table_iter_init(&it, grid->entries);
+    while (g_hash_table_iter_next(&it, NULL, &entry))
+        _link_entry(grid, (spatial_grid_entry_t *) entry);
+}
+
+void spatial_grid_clear(SpatialGrid * grid)
+{
+    g_hash_table_remove_all(grid->buckets);
+    g_hash_table_remove_all(grid->entries);
+}
+
+void spatial_grid_insert(SpatialGrid * grid, gpointer data, const GdkRectangle * rect)
+{
+    spatial_grid_entry_t * entry = g_hash_table_lookup(grid->entries, data);
+    if (entry)
+    {
+        if (entry->rect.x == rect->x && entry->rect.y == rect->y
+        &&  entry->rect.width == rect->width && entry->rect.height == rect->height)
+            return;
+        _unlink_entry(grid, entry);
+    }
+    else
+    {
+        entry = g_slice_new0(spatial_grid_entry_t);
+        entry->data = data;
+        g_hash_table_insert(grid->entries, data, entry);
+    }
+
+    entry->rect = *rect;
+    _link_entry(grid, entry);
+}
+
+void spatial_grid_remove(SpatialGrid * grid, gpointer data)
+{
+    spatial_grid_entry_t * entry = g_hash_table_lookup(grid->entries, data);
+    if (!entry)
+        return;
+    _unlink_entry(grid, entry);
+    g_hash_table_remove(grid->entries, data);
+}
+
+gboolean spatial_grid_contains(SpatialGrid * grid, gpointer data)
+{
+    return g_hash_table_lookup(grid->entries, data) != NULL;
+}
+
+static guint _next_stamp(SpatialGrid * grid)
+{
+    grid->stamp++;
+    if (G_UNLIKELY(grid->stamp == 0))
+    {
+        GHashTableIter it;
+        gpointer entry;
+        g_hash_table_iter_init(&it, grid->entries);
+        while (g_hash_table_iter_next(&it, NULL, &entry))
+            ((spatial_grid_entry_t *) entry)->stamp = 0;
+        grid->stamp = 1;
+    }
+    return grid->stamp;
+}
+
+gboolean spatial_grid_foreach_in_rect(SpatialGrid * grid, const GdkRectangle * rect,
+    SpatialGridFunc func, gpointer user_data)
+{
+    int cx0, cy0, cx1, cy1, cx, cy;
+    guint stamp;
+
+    if (_rect_is_empty(rect))
+        return FALSE;
+
+    _get_cell_range(grid, rect, &cx0, &cy0, &cx1, &cy1);
+
+    /* a query larger than the whole population is cheaper as a plain scan */
+    if ((gint64) (cx1 - cx0 + 1) * (cy1 - cy0 + 1) > (gint64) g_hash_table_size(grid->entries))
+    {
+        GHashTableIter it;
+        gpointer p;
+        g_hash_table_iter_init(&it, grid->entries);
+        while (g_hash_table_iter_next(&it, NULL, &p))
+        {
+            spatial_grid_entry_t * entry = (spatial_grid_entry_t *) p;
+            if (gdk_rectangle_intersect((GdkRectangle *) rect, &entry->rect, NULL))
+                if (func(entry->data, &entry->rect, user_data))
+                    return TRUE;
+        }
+        return FALSE;
+    }
+
+    stamp = _next_stamp(grid);
+
+    for (cy = cy0; cy <= cy1; cy++)
+    {
+        for (cx = cx0; cx <= cx1; cx++)
+        {
+            GPtrArray * bucket = g_hash_table_lookup(grid->buckets, _cell_key(cx, cy));
+            guint i;
+            if (!bucket)
+                continue;
+            for (i = 0; i < bucket->len; i++)
+            {
+                spatial_grid_entry_t * entry = g_ptr_array_index(bucket, i);
+                if (entry->stamp == stamp)
+                    continue;
+                entry->stamp = stamp;
+                if (gdk_rectangle_intersect((GdkRectangle *) rect, &entry->rect, NULL))
+                    if (func(entry->data, &entry->rect, user_data))
+                        return TRUE;
+            }
+        }
+    }
+
+    return FALSE;
+}
+
+static gboolean _test_rect_func(gpointer data, const GdkRectangle * rect, gpointer exclude)
+{
+    return data != exclude;
+}
+
+gboolean spatial_grid_test_rect(SpatialGrid * grid, const GdkRectangle * rect, gpointer exclude)
+{
+    return spatial_grid_foreach_in_rect(grid, rect, _test_rect_func, exclude);
+}
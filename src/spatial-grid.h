@@ -0,0 +1,64 @@
+/*
+ *      spatial-grid.h
+ *
+ *      Copyright (c) 2026 Vadim Ushakov
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+
+#ifndef __SPATIAL_GRID_H__
+#define __SPATIAL_GRID_H__
+
+#include <gdk/gdk.h>
+
+G_BEGIN_DECLS
+
+/*
+    SpatialGrid is a uniform grid of rectangles: every rectangle is put
+    into each bucket it covers, so a lookup only has to check the few
+    rectangles that share a bucket with the query instead of all of them.
+    Buckets are hashed, so rectangles may lie anywhere, including outside
+    of the screen.
+*/
+
+typedef struct _SpatialGrid SpatialGrid;
+
+/* Return TRUE to stop the iteration. */
+typedef gboolean (*SpatialGridFunc)(gpointer data, const GdkRectangle * rect, gpointer user_data);
+
+SpatialGrid * spatial_grid_new(int cell_w, int cell_h);
+void spatial_grid_free(SpatialGrid * grid);
+
+void spatial_grid_set_cell_size(SpatialGrid * grid, int cell_w, int cell_h);
+
+void spatial_grid_clear(SpatialGrid * grid);
+
+/* Inserts data or moves it to the new rect, if it is already in the grid. */
+void spatial_grid_insert(SpatialGrid * grid, gpointer data, const GdkRectangle * rect);
+void spatial_grid_remove(SpatialGrid * grid, gpointer data);
+gboolean spatial_grid_contains(SpatialGrid * grid, gpointer data);
+
+/* Calls func once for every rectangle that intersects rect. */
+gboolean spatial_grid_foreach_in_rect(SpatialGrid * grid, const GdkRectangle * rect,
+    SpatialGridFunc func, gpointer user_data);
+
+/* Checks if any rectangle except the one of exclude intersects rect. */
+gboolean spatial_grid_test_rect(SpatialGrid * grid, const GdkRectangle * rect, gpointer exclude);
+
+G_END_DECLS
+
+#endif /* __SPATIAL_GRID_H__ */
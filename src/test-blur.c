@@ -0,0 +1,176 @@
+/*
+ *      test-blur.c
+ *
+ *      Copyright (c) 2026 Vadim Ushakov
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+/*
+    Checks the SIMD column passes against the scalar one, and blur_a8()
+    against a plain two-pass convolution.
+*/
+
+#include <string.h>
+
+/* the passes are static */
+#include "blur.c"
+
+static void fill_random(guint8 * data, gsize size)
+{
+    gsize i;
+    for (i = 0; i < size; i++)
+        data[i] = g_random_int_range(0, 256);
+}
+
+/* widths around the 16 and 32 pixel steps */
+static const int widths[] = {1, 7, 15, 16, 17, 31, 32, 33, 63, 100};
+static const double sigmas[] = {0.5, 1.0, 2.5, 12.0};
+
+static void check_columns(BlurColumnsFunc func)
+{
+    guint w, s;
+
+    for (s = 0; s < G_N_ELEMENTS(sigmas); s++)
+    {
+        BlurKernel * kernel = blur_kernel_new(sigmas[s], 1.0);
+
+        for (w = 0; w < G_N_ELEMENTS(widths); w++)
+        {
+            int width = widths[w];
+            int height = g_random_int_range(1, 50);
+            int src_stride = width + 3;
+            guint8 * src = g_malloc(src_stride * height);
+            guint8 * expected = g_malloc(width * height);
+            guint8 * result = g_malloc(width * height);
+            int i;
+
+            fill_random(src, src_stride * height);
+            _blur_columns_scalar(src, src_stride, expected, width, width, height, kernel);
+            func(src, src_stride, result, width, width, height, kernel);
+            for (i = 0; i < width * height; i++)
+                g_assert_cmpuint(result[i], ==, expected[i]);
+
+            g_free(src);
+            g_free(expected);
+            g_free(result);
+        }
+
+        blur_kernel_free(kernel);
+    }
+}
+
+#ifdef CPU_FEATURES_X86
+static void test_columns_sse2(void)
+{
+    if (cpu_features_get() & CPU_FEATURE_SSE2)
+        check_columns(_blur_columns_sse2);
+}
+
+static void test_columns_avx2(void)
+{
+    if (cpu_features_get() & CPU_FEATURE_AVX2)
+        check_columns(_blur_columns_avx2);
+}
+#endif
+
+/* one pass along x (dx = 1) or y, with the pixels outside taken as 0 */
+static void reference_pass(const guint8 * src, guint8 * dst, int width, int height, int stride,
+    int dx, const BlurKernel * kernel)
+{
+    int x, y, t;
+    for (y = 0; y < height; y++)
+    {
+        for (x = 0; x < width; x++)
+        {
+            guint acc = 128;
+            for (t = -kernel->radius; t <= kernel->radius; t++)
+            {
+                int sx = dx ? x + t : x;
+                int sy = dx ? y : y + t;
+                if (sx >= 0 && sx < width && sy >= 0 && sy < height)
+                    acc += kernel->weights[t + kernel->radius] * src[sy * stride + sx];
+            }
+            dst[y * stride + x] = acc >> 8;
+        }
+    }
+}
+
+static void test_blur_a8(void)
+{
+    guint w, s;
+
+    for (s = 0; s < G_N_ELEMENTS(sigmas); s++)
+    {
+        BlurKernel * kernel = blur_kernel_new(sigmas[s], 1.7);
+
+        for (w = 0; w < G_N_ELEMENTS(widths); w++)
+        {
+            int width = widths[w];
+            int height = g_random_int_range(1, 40);
+            int stride = width + 5;
+            guint8 * data = g_malloc(stride * height);
+            guint8 * tmp = g_malloc(stride * height);
+            guint8 * expected = g_malloc(stride * height);
+            int x, y;
+
+            fill_random(data, stride * height);
+            reference_pass(data, tmp, width, height, stride, 0, kernel);
+            reference_pass(tmp, expected, width, height, stride, 1, kernel);
+
+            blur_a8(data, width, height, stride, kernel);
+            for (y = 0; y < height; y++)
+                for (x = 0; x < width; x++)
+                    g_assert_cmpuint(data[y * stride + x], ==, kernel->gain[expected[y * stride + x]]);
+
+            g_free(data);
+            g_free(tmp);
+            g_free(expected);
+        }
+
+        blur_kernel_free(kernel);
+    }
+}
+
+/* the weights add up to 1.0, so a flat area stays flat */
+static void test_kernel_weights(void)
+{
+    guint s;
+    for (s = 0; s < G_N_ELEMENTS(sigmas); s++)
+    {
+        BlurKernel * kernel = blur_kernel_new(sigmas[s], 1.0);
+        guint sum = 0;
+        int t;
+        for (t = 0; t <= kernel->radius * 2; t++)
+            sum += kernel->weights[t];
+        g_assert_cmpuint(sum, ==, 256);
+        blur_kernel_free(kernel);
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/blur/kernel-weights", test_kernel_weights);
+#ifdef CPU_FEATURES_X86
+    g_test_add_func("/blur/columns-sse2", test_columns_sse2);
+    g_test_add_func("/blur/columns-avx2", test_columns_avx2);
+#endif
+    g_test_add_func("/blur/blur-a8", test_blur_a8);
+
+    return g_test_run();
+}
@@ -0,0 +1,214 @@
+/*
+ *      test-cell-placement.c
+ *
+ *      Copyright (c) 2026 Vadim Ushakov
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+/*
+    Checks the positions the generator steps through, seeks to and skips
+    to against positions worked out from the cell index, in all eight
+    combinations of the placement rules.
+*/
+
+#include <string.h>
+
+#include "cell-placement-generator.h"
+
+#define RULES_IN_ROWS 1
+#define RULES_RTL 2
+#define RULES_BTT 4
+
+static void init_generator(CellPlacementGenerator * g, int rules)
+{
+    int left = g_random_int_range(-100, 100);
+    int top = g_random_int_range(-100, 100);
+
+    memset(g, 0, sizeof(*g));
+    cell_placement_generator_set_bounding_box(g, left, top,
+        left + g_random_int_range(1, 1000), top + g_random_int_range(1, 800));
+    cell_placement_generator_set_cell_size(g, g_random_int_range(8, 120), g_random_int_range(8, 120));
+    cell_placement_generator_set_placement_rules(g,
+        (rules & RULES_IN_ROWS) != 0, (rules & RULES_RTL) != 0, (rules & RULES_BTT) != 0);
+    cell_placement_generator_reset(g);
+}
+
+/* the position of the cell with the given index, the way the old
+   floating point code worked out the tier offsets */
+static void expected_position(CellPlacementGenerator * g, long index, long * x, long * y)
+{
+    long columns = cell_placement_generator_get_columns(g);
+    long rows = cell_placement_generator_get_rows(g);
+    long tier = index / (columns * rows);
+    long k = index % (columns * rows);
+    long col = g->arrange_in_rows ? k % columns : k / rows;
+    long row = g->arrange_in_rows ? k / columns : k % rows;
+    double x_div = g->arrange_in_rows ? 24 : 16;
+    double y_div = g->arrange_in_rows ? 16 : 24;
+
+    *x = g->arrange_rtl ? g->right_line - g->cell_w * (col + 1) : g->left_line + g->cell_w * col;
+    *y = g->arrange_btt ? g->bottom_line - g->cell_h * (row + 1) : g->top_line + g->cell_h * row;
+    if (tier)
+    {
+        *x += (long) ((1.0 + g->cell_w / (long) x_div) * tier * (g->arrange_rtl ? -1 : 1));
+        *y += (long) ((1.0 + g->cell_h / (long) y_div) * tier * (g->arrange_btt ? -1 : 1));
+    }
+}
+
+static void test_advance(void)
+{
+    int rules, round;
+
+    for (rules = 0; rules < 8; rules++)
+    {
+        for (round = 0; round < 20; round++)
+        {
+            CellPlacementGenerator g;
+            long tier_size, index;
+
+            init_generator(&g, rules);
+            tier_size = cell_placement_generator_get_tier_size(&g);
+            for (index = 0; index < tier_size * 3 + 5 && index < 20000; index++)
+            {
+                CellPlacementGenerator seek = g;
+                long x, y, tier;
+
+                expected_position(&g, index, &x, &y);
+                g_assert_cmpint(g.index, ==, index);
+                g_assert_cmpint(g.x, ==, x);
+                g_assert_cmpint(g.y, ==, y);
+                g_assert_cmpint(g.tier, ==, index / tier_size);
+
+                /* seek and get_nth land on the same position, with the same state */
+                cell_placement_generator_seek(&seek, index);
+                g_assert_cmpint(seek.x, ==, x);
+                g_assert_cmpint(seek.y, ==, y);
+                g_assert_cmpint(seek._i1, ==, g._i1);
+                g_assert_cmpint(seek._i2, ==, g._i2);
+                cell_placement_generator_get_nth(&g, index, &x, &y, &tier);
+                g_assert_cmpint(x, ==, g.x);
+                g_assert_cmpint(y, ==, g.y);
+                g_assert_cmpint(tier, ==, g.tier);
+
+                cell_placement_generator_advance(&g);
+            }
+        }
+    }
+}
+
+static gboolean is_blocked(const guint64 * map, long k)
+{
+    return (map[k >> 6] >> (k & 63)) & 1;
+}
+
+static void test_skip_occupied(void)
+{
+    int rules, round;
+
+    for (rules = 0; rules < 8; rules++)
+    {
+        for (round = 0; round < 20; round++)
+        {
+            CellPlacementGenerator g;
+            guint64 * map;
+            long tier_size, index, k;
+
+            init_generator(&g, rules);
+            tier_size = cell_placement_generator_get_tier_size(&g);
+            map = g_new0(guint64, cell_placement_generator_get_occupancy_map_size(&g));
+            /* block most of the cells, sometimes all of them */
+            for (k = 0; k < tier_size; k++)
+            {
+                if (round % 5 == 0 || g_random_int_range(0, 4) != 0)
+                    map[k >> 6] |= (guint64) 1 << (k & 63);
+            }
+            cell_placement_generator_set_occupancy_map(&g, map);
+
+            for (index = 0; index < tier_size * 2; index += g_random_int_range(1, 40))
+            {
+                long expected = index;
+                long x, y;
+
+                /* the first free cell from index on; stay put if there is none */
+                while (expected < index + tier_size * 2 && is_blocked(map, expected % tier_size))
+                    expected++;
+                if (expected == index + tier_size * 2)
+                    expected = index;
+
+                cell_placement_generator_seek(&g, index);
+                cell_placement_generator_skip_occupied(&g);
+                expected_position(&g, expected, &x, &y);
+                g_assert_cmpint(g.index, ==, expected);
+                g_assert_cmpint(g.x, ==, x);
+                g_assert_cmpint(g.y, ==, y);
+            }
+
+            g_free(map);
+        }
+    }
+}
+
+static void test_mark_occupied(void)
+{
+    int rules, round;
+
+    for (rules = 0; rules < 8; rules++)
+    {
+        for (round = 0; round < 50; round++)
+        {
+            CellPlacementGenerator g;
+            guint64 * map;
+            long tier_size, k;
+            long dx, dy, left, top, right, bottom;
+
+            init_generator(&g, rules);
+            tier_size = cell_placement_generator_get_tier_size(&g);
+            map = g_new0(guint64, cell_placement_generator_get_occupancy_map_size(&g));
+            cell_placement_generator_set_occupancy_map(&g, map);
+
+            dx = g_random_int_range(0, g.cell_w);
+            dy = g_random_int_range(0, g.cell_h);
+            left = g_random_int_range(g.left_line - 50, g.right_line);
+            top = g_random_int_range(g.top_line - 50, g.bottom_line);
+            right = left + g_random_int_range(0, 300);
+            bottom = top + g_random_int_range(0, 300);
+            cell_placement_generator_mark_occupied(&g, dx, dy, left, top, right, bottom);
+
+            /* a cell is blocked when its point at (dx, dy) is in the rect */
+            for (k = 0; k < tier_size; k++)
+            {
+                long x, y;
+                expected_position(&g, k, &x, &y);
+                g_assert_cmpint(is_blocked(map, k), ==,
+                    left <= x + dx && x + dx < right && top <= y + dy && y + dy < bottom);
+            }
+
+            g_free(map);
+        }
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/cell-placement/advance", test_advance);
+    g_test_add_func("/cell-placement/skip-occupied", test_skip_occupied);
+    g_test_add_func("/cell-placement/mark-occupied", test_mark_occupied);
+
+    return g_test_run();
+}
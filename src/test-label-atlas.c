@@ -0,0 +1,268 @@
+/*
+ *      test-label-atlas.c
+ *
+ *      Copyright (c) 2026 Vadim Ushakov
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+/*
+    Checks how the atlas packs entries into shelves, that compaction
+    keeps the masks, and which entries eviction drops.
+*/
+
+#include <string.h>
+
+/* for the pages and their shelves */
+#include "label-atlas.c"
+
+#define PAGE_SIZE 128
+#define PAGE_BYTES (PAGE_SIZE * PAGE_SIZE)
+
+/* 4 entries of this size fit across a page, 8 shelves down */
+#define ENTRY_W 30
+#define ENTRY_H 14
+#define ENTRIES_PER_PAGE 32
+
+static cairo_surface_t * target;
+
+static void check_entries(LabelAtlas * atlas)
+{
+    GList * p;
+
+    for (p = atlas->pages.head; p; p = p->next)
+    {
+        LabelAtlasPage * page = (LabelAtlasPage *) p->data;
+        GList * l;
+
+        for (l = page->entries.head; l; l = l->next)
+        {
+            LabelAtlasEntry * a = (LabelAtlasEntry *) l->data;
+            gboolean on_shelf = FALSE;
+            GList * m;
+            guint i;
+
+            g_assert_cmpint(a->page == page, ==, TRUE);
+            g_assert_cmpint(*a->owner == a, ==, TRUE);
+            g_assert_cmpint(a->x, >=, 0);
+            g_assert_cmpint(a->y, >=, 0);
+            g_assert_cmpint(a->x + a->width + GUTTER, <=, PAGE_SIZE);
+            g_assert_cmpint(a->y + a->height + GUTTER, <=, PAGE_SIZE);
+
+            for (i = 0; i < page->shelves->len; i++)
+            {
+                shelf_t * shelf = &g_array_index(page->shelves, shelf_t, i);
+                if (shelf->y == a->y && a->height + GUTTER <= shelf->height
+                &&  a->x + a->width + GUTTER <= shelf->used)
+                    on_shelf = TRUE;
+            }
+            g_assert_cmpint(on_shelf, ==, TRUE);
+
+            /* no two entries overlap, gutters included */
+            for (m = l->next; m; m = m->next)
+            {
+                LabelAtlasEntry * b = (LabelAtlasEntry *) m->data;
+                g_assert_cmpint(a->x + a->width + GUTTER <= b->x || b->x + b->width + GUTTER <= a->x
+                             || a->y + a->height + GUTTER <= b->y || b->y + b->height + GUTTER <= a->y, ==, TRUE);
+            }
+        }
+    }
+}
+
+static void test_packing(void)
+{
+    LabelAtlas * atlas = label_atlas_new(PAGE_SIZE, PAGE_BYTES * 4);
+    LabelAtlasEntry * owners[400];
+    int round, i;
+
+    memset(owners, 0, sizeof(owners));
+    for (round = 0; round < 20; round++)
+    {
+        for (i = 0; i < (int) G_N_ELEMENTS(owners); i++)
+        {
+            if (owners[i] && g_random_int_range(0, 3) == 0)
+            {
+                label_atlas_entry_free(owners[i]);
+                g_assert_cmpint(owners[i] == NULL, ==, TRUE);
+            }
+            else if (!owners[i] && g_random_int_range(0, 3) == 0)
+                label_atlas_alloc(atlas, target, g_random_int_range(1, 60), g_random_int_range(1, 30), &owners[i]);
+        }
+        check_entries(atlas);
+        g_assert_cmpuint(atlas->pages.length, <=, 4);
+    }
+
+    /* too large for a page */
+    g_assert_cmpint(label_atlas_alloc(atlas, target, PAGE_SIZE, 10, &owners[0]) == NULL, ==, TRUE);
+    g_assert_cmpint(owners[0] == NULL, ==, TRUE);
+
+    label_atlas_free(atlas);
+    for (i = 0; i < (int) G_N_ELEMENTS(owners); i++)
+        g_assert_cmpint(owners[i] == NULL, ==, TRUE);
+}
+
+static void test_shelves(void)
+{
+    LabelAtlas * atlas = label_atlas_new(PAGE_SIZE, PAGE_BYTES);
+    LabelAtlasEntry * owners[6];
+
+    /* labels of about the same height share a shelf */
+    label_atlas_alloc(atlas, target, 20, 13, &owners[0]);
+    label_atlas_alloc(atlas, target, 20, 11, &owners[1]);
+    label_atlas_alloc(atlas, target, 20, 13, &owners[2]);
+    g_assert_cmpint(owners[1]->y, ==, owners[0]->y);
+    g_assert_cmpint(owners[2]->y, ==, owners[0]->y);
+    g_assert_cmpint(owners[1]->x, ==, owners[0]->x + 20 + GUTTER);
+
+    /* a much taller one, or one that does not fit across, starts another */
+    label_atlas_alloc(atlas, target, 20, 40, &owners[3]);
+    g_assert_cmpint(owners[3]->y, !=, owners[0]->y);
+    label_atlas_alloc(atlas, target, 100, 13, &owners[4]);
+    g_assert_cmpint(owners[4]->y, !=, owners[0]->y);
+    /* and a smaller one goes to the lowest shelf it fits */
+    label_atlas_alloc(atlas, target, 10, 8, &owners[5]);
+    g_assert_cmpint(owners[5]->y, ==, owners[0]->y);
+
+    check_entries(atlas);
+    label_atlas_free(atlas);
+}
+
+static void fill_page(LabelAtlas * atlas, LabelAtlasEntry ** owners, guint8 first_value)
+{
+    int i;
+    for (i = 0; i < ENTRIES_PER_PAGE; i++)
+    {
+        cairo_t * cr;
+        g_assert_cmpint(label_atlas_alloc(atlas, target, ENTRY_W, ENTRY_H, &owners[i]) != NULL, ==, TRUE);
+        cr = label_atlas_entry_begin(owners[i]);
+        cairo_set_source_rgba(cr, 0, 0, 0, (first_value + i) / 255.0);
+        cairo_paint(cr);
+        cairo_destroy(cr);
+    }
+}
+
+/* every pixel of the entry still holds its value */
+static void check_mask(LabelAtlasEntry * entry, guint8 value)
+{
+    cairo_surface_t * surface = entry->page->surface;
+    const guint8 * data;
+    int stride, x, y;
+
+    cairo_surface_flush(surface);
+    data = cairo_image_surface_get_data(surface);
+    stride = cairo_image_surface_get_stride(surface);
+    for (y = entry->y; y < entry->y + entry->height; y++)
+        for (x = entry->x; x < entry->x + entry->width; x++)
+            g_assert_cmpuint(data[y * stride + x], ==, value);
+}
+
+static void test_compaction(void)
+{
+    LabelAtlas * atlas = label_atlas_new(PAGE_SIZE, PAGE_BYTES);
+    LabelAtlasEntry * owners[ENTRIES_PER_PAGE];
+    LabelAtlasEntry * more[ENTRIES_PER_PAGE / 2];
+    LabelAtlasStats stats;
+    int i;
+
+    fill_page(atlas, owners, 1);
+    for (i = 0; i < ENTRIES_PER_PAGE; i += 2)
+        label_atlas_entry_free(owners[i]);
+
+    /* the page is full of holes, so it gets packed again to make room */
+    for (i = 0; i < ENTRIES_PER_PAGE / 2; i++)
+        g_assert_cmpint(label_atlas_alloc(atlas, target, ENTRY_W, ENTRY_H, &more[i]) != NULL, ==, TRUE);
+
+    label_atlas_get_stats(atlas, &stats);
+    g_assert_cmpuint(stats.evictions, ==, 0);
+    g_assert_cmpuint(atlas->pages.length, ==, 1);
+    for (i = 1; i < ENTRIES_PER_PAGE; i += 2)
+    {
+        g_assert_cmpint(owners[i] != NULL, ==, TRUE);
+        check_mask(owners[i], 1 + i);
+    }
+    check_entries(atlas);
+
+    label_atlas_free(atlas);
+}
+
+static void test_eviction(void)
+{
+    LabelAtlas * atlas = label_atlas_new(PAGE_SIZE, PAGE_BYTES * 2);
+    LabelAtlasEntry * first[ENTRIES_PER_PAGE];
+    LabelAtlasEntry * second[ENTRIES_PER_PAGE];
+    LabelAtlasEntry * extra;
+    LabelAtlasStats stats;
+    cairo_surface_t * screen = cairo_image_surface_create(CAIRO_FORMAT_A8, 64, 64);
+    cairo_t * cr = cairo_create(screen);
+    int i;
+
+    fill_page(atlas, first, 1);
+    fill_page(atlas, second, 1);
+    g_assert_cmpint(first[0]->page != second[0]->page, ==, TRUE);
+
+    /* painting an entry of the first page makes the second one the least recently used */
+    label_atlas_entry_mask(first[5], cr, 0, 0);
+
+    g_assert_cmpint(label_atlas_alloc(atlas, target, ENTRY_W, ENTRY_H, &extra) != NULL, ==, TRUE);
+    for (i = 0; i < ENTRIES_PER_PAGE; i++)
+    {
+        g_assert_cmpint(first[i] != NULL, ==, TRUE);
+        g_assert_cmpint(second[i] == NULL, ==, TRUE);
+    }
+
+    label_atlas_get_stats(atlas, &stats);
+    g_assert_cmpuint(stats.evictions, ==, ENTRIES_PER_PAGE);
+    g_assert_cmpuint(stats.hits, ==, 1);
+    g_assert_cmpuint(stats.misses, ==, ENTRIES_PER_PAGE * 2 + 1);
+    g_assert_cmpuint(stats.bytes, ==, PAGE_BYTES * 2);
+
+    /* a smaller budget drops the least recently used page, which now is the first one */
+    label_atlas_set_budget(atlas, PAGE_BYTES);
+    label_atlas_get_stats(atlas, &stats);
+    g_assert_cmpuint(stats.bytes, ==, PAGE_BYTES);
+    g_assert_cmpuint(stats.budget, ==, PAGE_BYTES);
+    g_assert_cmpint(extra != NULL, ==, TRUE);
+    for (i = 0; i < ENTRIES_PER_PAGE; i++)
+        g_assert_cmpint(first[i] == NULL, ==, TRUE);
+
+    /* the budget holds one page at least */
+    label_atlas_set_budget(atlas, 1);
+    label_atlas_get_stats(atlas, &stats);
+    g_assert_cmpuint(stats.budget, ==, PAGE_BYTES);
+
+    label_atlas_free(atlas);
+    g_assert_cmpint(extra == NULL, ==, TRUE);
+    cairo_destroy(cr);
+    cairo_surface_destroy(screen);
+}
+
+int main(int argc, char ** argv)
+{
+    int result;
+
+    g_test_init(&argc, &argv, NULL);
+
+    target = cairo_image_surface_create(CAIRO_FORMAT_A8, 1, 1);
+
+    g_test_add_func("/label-atlas/packing", test_packing);
+    g_test_add_func("/label-atlas/shelves", test_shelves);
+    g_test_add_func("/label-atlas/compaction", test_compaction);
+    g_test_add_func("/label-atlas/eviction", test_eviction);
+
+    result = g_test_run();
+    cairo_surface_destroy(target);
+    return result;
+}
@@ -0,0 +1,149 @@
+/*
+ *      test-rect-batch.c
+ *
+ *      Copyright (c) 2026 Vadim Ushakov
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+/*
+    Checks every rect_batch_intersect() variant against
+    gdk_rectangle_intersect(), on random rects and at every start
+    offset within a mask word.
+*/
+
+#include <string.h>
+
+/* the variants are static */
+#include "rect-batch.c"
+
+#define N_RECTS 333
+
+static void fill_random_rects(GdkRectangle * rects, guint n)
+{
+    guint i;
+    for (i = 0; i < n; i++)
+    {
+        /* small numbers, so edges touch often; some rects are empty or negative */
+        rects[i].x = g_random_int_range(-20, 100);
+        rects[i].y = g_random_int_range(-20, 100);
+        rects[i].width = g_random_int_range(-2, 40);
+        rects[i].height = g_random_int_range(-2, 40);
+    }
+}
+
+static void expect_mask(const GdkRectangle * rects, guint from, guint n,
+    const GdkRectangle * rect, guint32 * mask)
+{
+    guint i;
+    memset(mask, 0, RECT_BATCH_MASK_WORDS(n) * sizeof(guint32));
+    if (rect->width <= 0 || rect->height <= 0)
+        return;
+    for (i = from; i < n; i++)
+    {
+        if (rects[i].width > 0 && rects[i].height > 0
+        &&  gdk_rectangle_intersect(&rects[i], rect, NULL))
+            mask[i / 32] |= 1u << (i % 32);
+    }
+}
+
+static void check_variant(RectBatchFunc func)
+{
+    GdkRectangle rects[N_RECTS];
+    guint32 expected[RECT_BATCH_MASK_WORDS(N_RECTS)];
+    guint32 mask[RECT_BATCH_MASK_WORDS(N_RECTS)];
+    int round;
+
+    for (round = 0; round < 200; round++)
+    {
+        GdkRectangle rect;
+        guint from, i;
+
+        fill_random_rects(rects, N_RECTS);
+        fill_random_rects(&rect, 1);
+        if (rect.width <= 0 || rect.height <= 0)
+            continue;
+
+        for (from = 0; from < 40; from++)
+        {
+            expect_mask(rects, from, N_RECTS, &rect, expected);
+            memset(mask, 0, sizeof(mask));
+            func(rects, from, N_RECTS, rect.x, rect.y, rect.x + rect.width, rect.y + rect.height, mask);
+            for (i = 0; i < G_N_ELEMENTS(mask); i++)
+                g_assert_cmpuint(mask[i], ==, expected[i]);
+        }
+    }
+}
+
+static void test_scalar(void)
+{
+    check_variant(_test_scalar);
+}
+
+#ifdef CPU_FEATURES_X86
+static void test_sse2(void)
+{
+    if (cpu_features_get() & CPU_FEATURE_SSE2)
+        check_variant(_test_sse2);
+}
+
+static void test_avx2(void)
+{
+    if (cpu_features_get() & CPU_FEATURE_AVX2)
+        check_variant(_test_avx2);
+}
+#endif
+
+static void test_intersect(void)
+{
+    GdkRectangle rects[N_RECTS];
+    guint32 expected[RECT_BATCH_MASK_WORDS(N_RECTS)];
+    guint32 mask[RECT_BATCH_MASK_WORDS(N_RECTS)];
+    GdkRectangle empty = {10, 10, 0, 5};
+    guint n, i;
+
+    fill_random_rects(rects, N_RECTS);
+    for (n = 1; n <= N_RECTS; n += 17)
+    {
+        GdkRectangle rect = {30, 20, 25, 15};
+        expect_mask(rects, 0, n, &rect, expected);
+        /* bits past n have to come out clear */
+        memset(mask, 0xff, sizeof(mask));
+        rect_batch_intersect(rects, n, &rect, mask);
+        for (i = 0; i < RECT_BATCH_MASK_WORDS(n); i++)
+            g_assert_cmpuint(mask[i], ==, expected[i]);
+    }
+
+    /* an empty query rect matches nothing */
+    memset(mask, 0xff, sizeof(mask));
+    rect_batch_intersect(rects, N_RECTS, &empty, mask);
+    for (i = 0; i < G_N_ELEMENTS(mask); i++)
+        g_assert_cmpuint(mask[i], ==, 0);
+}
+
+int main(int argc, char ** argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/rect-batch/scalar", test_scalar);
+#ifdef CPU_FEATURES_X86
+    g_test_add_func("/rect-batch/sse2", test_sse2);
+    g_test_add_func("/rect-batch/avx2", test_avx2);
+#endif
+    g_test_add_func("/rect-batch/intersect", test_intersect);
+
+    return g_test_run();
+}
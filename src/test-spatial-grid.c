@@ -0,0 +1,177 @@
+/*
+ *      test-spatial-grid.c
+ *
+ *      Copyright (c) 2026 Vadim Ushakov
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+/*
+    Checks that a lookup visits every rect that intersects the query
+    exactly once, against a plain scan, while rects are moved, removed
+    and spread over buckets shared by far away cells.
+*/
+
+#include <string.h>
+
+/* for the stamp of the grid */
+#include "spatial-grid.c"
+
+#define N_RECTS 200
+
+typedef struct
+{
+    GdkRectangle rects[N_RECTS];
+    gboolean present[N_RECTS];
+    guint visits[N_RECTS];
+} test_data_t;
+
+static void random_rect(GdkRectangle * rect)
+{
+    /* cells 65536 apart share a bucket, so put some rects that far away */
+    int far = g_random_int_range(0, 4) == 0 ? 65536 * 20 : 0;
+    rect->x = g_random_int_range(-300, 300) + far;
+    rect->y = g_random_int_range(-300, 300);
+    rect->width = g_random_int_range(-5, 150);
+    rect->height = g_random_int_range(-5, 150);
+}
+
+static gboolean count_visit(gpointer data, const GdkRectangle * rect, gpointer user_data)
+{
+    test_data_t * test = (test_data_t *) user_data;
+    test->visits[GPOINTER_TO_UINT(data) - 1]++;
+    return FALSE;
+}
+
+static void check_query(SpatialGrid * grid, test_data_t * test, const GdkRectangle * query)
+{
+    guint i;
+
+    memset(test->visits, 0, sizeof(test->visits));
+    spatial_grid_foreach_in_rect(grid, query, count_visit, test);
+    for (i = 0; i < N_RECTS; i++)
+    {
+        gboolean hit = test->present[i] && gdk_rectangle_intersect(&test->rects[i], query, NULL);
+        g_assert_cmpuint(test->visits[i], ==, hit ? 1 : 0);
+    }
+}
+
+static void check_grid(SpatialGrid * grid, test_data_t * test, int n_queries)
+{
+    int q;
+
+    for (q = 0; q < n_queries; q++)
+    {
+        GdkRectangle query;
+        random_rect(&query);
+        /* now and then a query larger than the whole population */
+        if (q % 10 == 0)
+            query.width = query.height = 100000;
+        check_query(grid, test, &query);
+    }
+}
+
+static void test_foreach_in_rect(void)
+{
+    SpatialGrid * grid = spatial_grid_new(g_random_int_range(1, 100), g_random_int_range(1, 100));
+    test_data_t test;
+    int round;
+    guint i;
+
+    memset(&test, 0, sizeof(test));
+
+    for (round = 0; round < 50; round++)
+    {
+        /* insert, move or remove a few rects */
+        for (i = 0; i < 40; i++)
+        {
+            guint k = g_random_int_range(0, N_RECTS);
+            gpointer data = GUINT_TO_POINTER(k + 1);
+            if (g_random_int_range(0, 5) == 0)
+            {
+                spatial_grid_remove(grid, data);
+                test.present[k] = FALSE;
+            }
+            else
+            {
+                random_rect(&test.rects[k]);
+                spatial_grid_insert(grid, data, &test.rects[k]);
+                test.present[k] = TRUE;
+            }
+            g_assert_cmpint(spatial_grid_contains(grid, data), ==, test.present[k]);
+        }
+
+        if (round % 10 == 9)
+            spatial_grid_set_cell_size(grid, g_random_int_range(1, 100), g_random_int_range(1, 100));
+
+        check_grid(grid, &test, 20);
+    }
+
+    spatial_grid_free(grid);
+}
+
+/* the stamps that mark visited entries wrap around */
+static void test_stamp_wrap(void)
+{
+    SpatialGrid * grid = spatial_grid_new(16, 16);
+    test_data_t test;
+    guint i;
+
+    memset(&test, 0, sizeof(test));
+    for (i = 0; i < N_RECTS; i++)
+    {
+        random_rect(&test.rects[i]);
+        spatial_grid_insert(grid, GUINT_TO_POINTER(i + 1), &test.rects[i]);
+        test.present[i] = TRUE;
+    }
+
+    grid->stamp = G_MAXUINT - 3;
+    check_grid(grid, &test, 20);
+
+    spatial_grid_free(grid);
+}
+
+static void test_test_rect(void)
+{
+    SpatialGrid * grid = spatial_grid_new(10, 10);
+    GdkRectangle a = {0, 0, 30, 30};
+    GdkRectangle b = {25, 25, 30, 30};
+    GdkRectangle query = {5, 5, 10, 10};
+
+    spatial_grid_insert(grid, &a, &a);
+    g_assert_cmpint(spatial_grid_test_rect(grid, &query, NULL), ==, TRUE);
+    g_assert_cmpint(spatial_grid_test_rect(grid, &query, &a), ==, FALSE);
+
+    spatial_grid_insert(grid, &b, &b);
+    g_assert_cmpint(spatial_grid_test_rect(grid, &b, &b), ==, TRUE);
+    g_assert_cmpint(spatial_grid_test_rect(grid, &query, &a), ==, FALSE);
+
+    spatial_grid_clear(grid);
+    g_assert_cmpint(spatial_grid_test_rect(grid, &b, NULL), ==, FALSE);
+
+    spatial_grid_free(grid);
+}
+
+int main(int argc, char ** argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/spatial-grid/foreach-in-rect", test_foreach_in_rect);
+    g_test_add_func("/spatial-grid/stamp-wrap", test_stamp_wrap);
+    g_test_add_func("/spatial-grid/test-rect", test_test_rect);
+
+    return g_test_run();
+}
@@ -0,0 +1,145 @@
+/*
+ *      test-text-extents-cache.c
+ *
+ *      Copyright (c) 2026 Vadim Ushakov
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+/*
+    Checks which keys hit the text extents cache and that it drops
+    the least recently used entries once it is full.
+*/
+
+#include <stdio.h>
+
+/* for CAPACITY and the lru queue */
+#include "text-extents-cache.c"
+
+static const char * font_key;
+
+static void reset(void)
+{
+    _ensure_table();
+    g_hash_table_remove_all(entries);
+    g_assert_cmpuint(lru.length, ==, 0);
+}
+
+static PangoRectangle make_rect(int i)
+{
+    PangoRectangle rect = { i, -i, i * 3, i + 7 };
+    return rect;
+}
+
+static gboolean lookup_rect(const char * text, int i)
+{
+    PangoRectangle rect;
+    PangoRectangle expected = make_rect(i);
+    if (!text_extents_cache_lookup(text, font_key, 100, 40, &rect))
+        return FALSE;
+    g_assert_cmpint(rect.x, ==, expected.x);
+    g_assert_cmpint(rect.y, ==, expected.y);
+    g_assert_cmpint(rect.width, ==, expected.width);
+    g_assert_cmpint(rect.height, ==, expected.height);
+    return TRUE;
+}
+
+static void test_keys(void)
+{
+    PangoRectangle rect = make_rect(5);
+    char text[16];
+
+    reset();
+    g_assert_cmpint(lookup_rect("name", 5), ==, FALSE);
+
+    /* the text is copied */
+    strcpy(text, "name");
+    text_extents_cache_insert(text, font_key, 100, 40, &rect);
+    strcpy(text, "other");
+    g_assert_cmpint(lookup_rect("name", 5), ==, TRUE);
+    g_assert_cmpint(lookup_rect("other", 5), ==, FALSE);
+
+    /* every part of the key counts */
+    g_assert_cmpint(text_extents_cache_lookup("name", g_intern_static_string("Serif 10"), 100, 40, &rect), ==, FALSE);
+    g_assert_cmpint(text_extents_cache_lookup("name", font_key, 101, 40, &rect), ==, FALSE);
+    g_assert_cmpint(text_extents_cache_lookup("name", font_key, 100, 41, &rect), ==, FALSE);
+
+    /* inserting the same key again replaces the extents */
+    rect = make_rect(6);
+    text_extents_cache_insert("name", font_key, 100, 40, &rect);
+    g_assert_cmpint(lookup_rect("name", 6), ==, TRUE);
+    g_assert_cmpuint(lru.length, ==, 1);
+    g_assert_cmpuint(g_hash_table_size(entries), ==, 1);
+}
+
+static void insert_numbered(int i)
+{
+    PangoRectangle rect = make_rect(i);
+    char text[16];
+    sprintf(text, "%d", i);
+    text_extents_cache_insert(text, font_key, 100, 40, &rect);
+}
+
+static gboolean lookup_numbered(int i)
+{
+    char text[16];
+    sprintf(text, "%d", i);
+    return lookup_rect(text, i);
+}
+
+static void test_lru(void)
+{
+    char text[16];
+    int i;
+
+    reset();
+    for (i = 0; i < CAPACITY; i++)
+        insert_numbered(i);
+    g_assert_cmpuint(lru.length, ==, CAPACITY);
+
+    /* a hit makes the oldest entry the most recently used one,
+       so the next insertions drop the entries after it */
+    g_assert_cmpint(lookup_numbered(0), ==, TRUE);
+    insert_numbered(CAPACITY);
+    insert_numbered(CAPACITY + 1);
+
+    g_assert_cmpuint(lru.length, ==, CAPACITY);
+    g_assert_cmpuint(g_hash_table_size(entries), ==, CAPACITY);
+    g_assert_cmpint(lookup_numbered(0), ==, TRUE);
+    g_assert_cmpint(lookup_numbered(1), ==, FALSE);
+    g_assert_cmpint(lookup_numbered(2), ==, FALSE);
+    g_assert_cmpint(lookup_numbered(3), ==, TRUE);
+    g_assert_cmpint(lookup_numbered(CAPACITY + 1), ==, TRUE);
+
+    /* the queue runs from the most recently used entry to the least */
+    sprintf(text, "%d", CAPACITY + 1);
+    g_assert_cmpstr(((text_extents_entry_t *) lru.head->data)->key.text, ==, text);
+    g_assert_cmpstr(((text_extents_entry_t *) lru.tail->data)->key.text, ==, "4");
+
+    reset();
+}
+
+int main(int argc, char ** argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    font_key = g_intern_static_string("Sans 10@96#0");
+
+    g_test_add_func("/text-extents-cache/keys", test_keys);
+    g_test_add_func("/text-extents-cache/lru", test_lru);
+
+    return g_test_run();
+}
@@ -0,0 +1,179 @@
+/*
+ *      text-extents-cache.c
+ *
+ *      Copyright (c) 2026 Vadim Ushakov
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "text-extents-cache.h"
+
+#include <string.h>
+
+#define CAPACITY 16384
+
+typedef struct _text_extents_key
+{
+    const char * text;
+    const char * font_key; /* interned */
+    int width;
+    int height;
+} text_extents_key_t;
+
+typedef struct _text_extents_entry
+{
+    text_extents_key_t key;
+    PangoRectangle logical_rect;
+    GList link; /* in lru, the most recently used first */
+} text_extents_entry_t;
+
+static GHashTable * entries = NULL; /* text_extents_key_t -> text_extents_entry_t */
+static GQueue lru = G_QUEUE_INIT;
+
+static guint _key_hash(gconstpointer p)
+{
+    const text_extents_key_t * key = (const text_extents_key_t *) p;
+    guint h = g_str_hash(key->text);
+    h = h * 31 + g_direct_hash(key->font_key);
+    h = h * 31 + (guint) key->width;
+    h = h * 31 + (guint) key->height;
+    return h;
+}
+
+static gboolean _key_equal(gconstpointer a, gconstpointer b)
+{
+    const text_extents_key_t * ka = (const text_extents_key_t *) a;
+    const text_extents_key_t * kb = (const text_extents_key_t *) b;
+    return ka->font_key == kb->font_key
+        && ka->width == kb->width
+        && ka->height == kb->height
+        && strcmp(ka->text, kb->text) == 0;
+}
+
+static void _free_entry(gpointer p)
+{
+    text_extents_entry_t * entry = (text_extents_entry_t *) p;
+    g_queue_unlink(&lru, &entry->link);
+    g_free((char *) entry->key.text);
+    g_slice_free(text_extents_entry_t, entry);
+}
+
+static void _ensure_table(void)
+{
+    if (!entries)
+        entries = g_hash_table_new_full(_key_hash, _key_equal, NULL, _free_entry);
+}
+
+static void _trim(guint size)
+{
+    while (lru.length > size)
+    {
+        text_extents_entry_t * entry = (text_extents_entry_t *) lru.tail->data;
+        g_hash_table_remove(entries, &entry->key);
+    }
+}
+
+const char * text_extents_cache_get_font_key(PangoContext * pc)
+{
+    const PangoFontDescription * font_desc = pango_context_get_font_description(pc);
+    char * font_name = pango_font_description_to_string(font_desc);
+    const cairo_font_options_t * options = pango_cairo_context_get_font_options(pc);
+    /* the same font shapes differently at another resolution or hinting */
+    char * s = g_strdup_printf("%s@%g#%lx", font_name, pango_cairo_context_get_resolution(pc),
+                               options ? cairo_font_options_hash(options) : 0UL);
+    const char * font_key = g_intern_string(s);
+    g_free(s);
+    g_free(font_name);
+    return font_key;
+}
+
+gboolean text_extents_cache_lookup(const char * text, const char * font_key,
+    int width, int height, PangoRectangle * logical_rect)
+{
+    text_extents_key_t key = { text, font_key, width, height };
+    text_extents_entry_t * entry;
+
+    if (!entries)
+        return FALSE;
+
+    entry = g_hash_table_lookup(entries, &key);
+    if (!entry)
+        return FALSE;
+
+    if (lru.head != &entry->link)
+    {
+        g_queue_unlink(&lru, &entry->link);
+        g_queue_push_head_link(&lru, &entry->link);
+    }
+
+    *logical_rect = entry->logical_rect;
+    return TRUE;
+}
+
+void text_extents_cache_insert(const char * text, const char * font_key,
+    int width, int height, const PangoRectangle * logical_rect)
+{
+    text_extents_key_t key = { text, font_key, width, height };
+    text_extents_entry_t * entry;
+
+    _ensure_table();
+
+    entry = g_hash_table_lookup(entries, &key);
+    if (entry)
+    {
+        entry->logical_rect = *logical_rect;
+        g_queue_unlink(&lru, &entry->link);
+        g_queue_push_head_link(&lru, &entry->link);
+        return;
+    }
+
+    _trim(CAPACITY - 1);
+
+    entry = g_slice_new0(text_extents_entry_t);
+    entry->key.text = g_strdup(text);
+    entry->key.font_key = font_key;
+    entry->key.width = width;
+    entry->key.height = height;
+    entry->logical_rect = *logical_rect;
+    entry->link.data = entry;
+    g_queue_push_head_link(&lru, &entry->link);
+    g_hash_table_insert(entries, &entry->key, entry);
+}
+
+void text_extents_cache_measure(PangoLayout * layout, const char * font_key,
+    const char * text, PangoRectangle * logical_rect)
+{
+    int width = pango_layout_get_width(layout);
+    int height = pango_layout_get_height(layout);
+    PangoRectangle ink_rect;
+
+    if (!text)
+        text = "";
+
+    if (font_key && text_extents_cache_lookup(text, font_key, width, height, logical_rect))
+        return;
+
+    pango_layout_set_text(layout, text, -1);
+    pango_layout_get_pixel_extents(layout, &ink_rect, logical_rect);
+    pango_layout_set_text(layout, NULL, 0);
+
+    if (font_key)
+        text_extents_cache_insert(text, font_key, width, height, logical_rect);
+}
@@ -0,0 +1,55 @@
+/*
+ *      text-extents-cache.h
+ *
+ *      Copyright (c) 2026 Vadim Ushakov
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+
+#ifndef __TEXT_EXTENTS_CACHE_H__
+#define __TEXT_EXTENTS_CACHE_H__
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+/*
+    A process-wide LRU cache of label extents, shared by all desktops.
+    An entry is keyed by the text, the font, and the width and height
+    the layout is limited to, so switching fonts or icon sizes back and
+    forth, or adding a monitor, does not shape the same names again.
+    The cache is only used from the main thread.
+*/
+
+/* Returns an interned string identifying the font of the context. */
+const char * text_extents_cache_get_font_key(PangoContext * pc);
+
+gboolean text_extents_cache_lookup(const char * text, const char * font_key,
+    int width, int height, PangoRectangle * logical_rect);
+
+void text_extents_cache_insert(const char * text, const char * font_key,
+    int width, int height, const PangoRectangle * logical_rect);
+
+/* Gets the pixel logical extents of text laid out with layout,
+   reusing a cached result if there is one.
+   The layout's text is left empty. */
+void text_extents_cache_measure(PangoLayout * layout, const char * font_key,
+    const char * text, PangoRectangle * logical_rect);
+
+G_END_DECLS
+
+#endif /* __TEXT_EXTENTS_CACHE_H__ */
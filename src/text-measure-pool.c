@@ -0,0 +1,249 @@
+/*
+ *      text-measure-pool.c
+ *
+ *      Copyright (c) 2026 Vadim Ushakov
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "text-measure-pool.h"
+#include "text-extents-cache.h"
+
+#include <unistd.h>
+
+#define BATCH_SIZE 128
+
+struct _TextMeasureRequest
+{
+    volatile gint ref_count;
+    volatile gint cancelled;
+    volatile gint pending_batches;
+
+    /* layout settings */
+    PangoFontDescription * font_desc;
+    cairo_font_options_t * font_options;
+    double resolution;
+    PangoLanguage * language;
+    PangoDirection base_dir;
+    PangoAlignment alignment;
+    PangoEllipsizeMode ellipsize;
+    PangoWrapMode wrap;
+    int width;
+    int height;
+
+    const char * font_key;
+    GPtrArray * texts;
+    PangoRectangle * logical_rects;
+
+    TextMeasureDoneFunc done;
+    gpointer user_data;
+};
+
+typedef struct _text_measure_batch
+{
+    TextMeasureRequest * request;
+    guint start;
+    guint end;
+} text_measure_batch_t;
+
+/* Pango objects are not thread-safe, so a worker takes a context
+   of its own from here for the time it measures a batch. */
+typedef struct _text_measure_worker
+{
+    PangoFontMap * font_map;
+    PangoContext * context;
+    PangoLayout * layout;
+} text_measure_worker_t;
+
+static GThreadPool * pool = NULL;
+static GAsyncQueue * idle_workers = NULL;
+
+gboolean text_measure_pool_is_available(void)
+{
+    return pango_version() >= PANGO_VERSION_ENCODE(1, 32, 0);
+}
+
+static int _get_n_workers(void)
+{
+#if GLIB_CHECK_VERSION(2, 36, 0)
+    int n = g_get_num_processors();
+#else
+    int n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return CLAMP(n, 1, 16);
+}
+
+static text_measure_worker_t * _get_worker(void)
+{
+    text_measure_worker_t * worker = g_async_queue_try_pop(idle_workers);
+    if (worker)
+        return worker;
+
+    worker = g_slice_new0(text_measure_worker_t);
+    worker->font_map = pango_cairo_font_map_new();
+    worker->context = pango_font_map_create_context(worker->font_map);
+    worker->layout = pango_layout_new(worker->context);
+    return worker;
+}
+
+static void _setup_worker(text_measure_worker_t * worker, TextMeasureRequest * request)
+{
+    pango_cairo_context_set_resolution(worker->context, request->resolution);
+    pango_cairo_context_set_font_options(worker->context, request->font_options);
+    pango_context_set_font_description(worker->context, request->font_desc);
+    pango_context_set_language(worker->context, request->language);
+    pango_context_set_base_dir(worker->context, request->base_dir);
+    pango_layout_context_changed(worker->layout);
+
+    pango_layout_set_alignment(worker->layout, request->alignment);
+    pango_layout_set_ellipsize(worker->layout, request->ellipsize);
+    pango_layout_set_wrap(worker->layout, request->wrap);
+    pango_layout_set_width(worker->layout, request->width);
+    pango_layout_set_height(worker->layout, request->height);
+}
+
+static TextMeasureRequest * _request_ref(TextMeasureRequest * request)
+{
+    g_atomic_int_inc(&request->ref_count);
+    return request;
+}
+
+static void _request_unref(TextMeasureRequest * request)
+{
+    if (!g_atomic_int_dec_and_test(&request->ref_count))
+        return;
+
+    pango_font_description_free(request->font_desc);
+    if (request->font_options)
+        cairo_font_options_destroy(request->font_options);
+    g_ptr_array_free(request->texts, TRUE);
+    g_free(request->logical_rects);
+    g_slice_free(TextMeasureRequest, request);
+}
+
+/* runs in the main loop once every batch is measured */
+static gboolean _on_request_finished(gpointer user_data)
+{
+    TextMeasureRequest * request = (TextMeasureRequest *) user_data;
+
+    if (!g_atomic_int_get(&request->cancelled))
+    {
+        guint i;
+        for (i = 0; i < request->texts->len; i++)
+        {
+            text_extents_cache_insert(g_ptr_array_index(request->texts, i), request->font_key,
+                request->width, request->height, &request->logical_rects[i]);
+        }
+        request->done(request->user_data);
+        _request_unref(request); /* the reference of the caller */
+    }
+
+    _request_unref(request);
+    return FALSE;
+}
+
+static void _measure_batch(gpointer data, gpointer unused)
+{
+    text_measure_batch_t * batch = (text_measure_batch_t *) data;
+    TextMeasureRequest * request = batch->request;
+
+    if (!g_atomic_int_get(&request->cancelled))
+    {
+        text_measure_worker_t * worker = _get_worker();
+        PangoRectangle ink_rect;
+        guint i;
+
+        _setup_worker(worker, request);
+        for (i = batch->start; i < batch->end; i++)
+        {
+            pango_layout_set_text(worker->layout, g_ptr_array_index(request->texts, i), -1);
+            pango_layout_get_pixel_extents(worker->layout, &ink_rect, &request->logical_rects[i]);
+        }
+        pango_layout_set_text(worker->layout, NULL, 0);
+
+        g_async_queue_push(idle_workers, worker);
+    }
+
+    if (g_atomic_int_dec_and_test(&request->pending_batches))
+        g_idle_add_full(G_PRIORITY_DEFAULT, _on_request_finished, request, NULL);
+    else
+        _request_unref(request);
+
+    g_slice_free(text_measure_batch_t, batch);
+}
+
+TextMeasureRequest * text_measure_request_new(PangoLayout * layout, const char * font_key,
+    GPtrArray * texts, TextMeasureDoneFunc done, gpointer user_data)
+{
+    PangoContext * pc = pango_layout_get_context(layout);
+    const cairo_font_options_t * font_options = pango_cairo_context_get_font_options(pc);
+    TextMeasureRequest * request;
+    guint start;
+
+    if (!pool)
+    {
+        pool = g_thread_pool_new(_measure_batch, NULL, _get_n_workers(), FALSE, NULL);
+        idle_workers = g_async_queue_new();
+    }
+
+    request = g_slice_new0(TextMeasureRequest);
+    request->ref_count = 1;
+    request->font_desc = pango_font_description_copy(pango_context_get_font_description(pc));
+    request->font_options = font_options ? cairo_font_options_copy(font_options) : NULL;
+    request->resolution = pango_cairo_context_get_resolution(pc);
+    request->language = pango_context_get_language(pc);
+    request->base_dir = pango_context_get_base_dir(pc);
+    request->alignment = pango_layout_get_alignment(layout);
+    request->ellipsize = pango_layout_get_ellipsize(layout);
+    request->wrap = pango_layout_get_wrap(layout);
+    request->width = pango_layout_get_width(layout);
+    request->height = pango_layout_get_height(layout);
+    request->font_key = font_key;
+    request->texts = texts;
+    request->logical_rects = g_new0(PangoRectangle, MAX(texts->len, 1));
+    request->done = done;
+    request->user_data = user_data;
+
+    if (texts->len == 0)
+    {
+        /* nothing to measure, just report back from the main loop */
+        g_idle_add_full(G_PRIORITY_DEFAULT, _on_request_finished, _request_ref(request), NULL);
+        return request;
+    }
+
+    /* every batch holds a reference, the last one hands it over to _on_request_finished() */
+    request->pending_batches = (texts->len + BATCH_SIZE - 1) / BATCH_SIZE;
+    for (start = 0; start < texts->len; start += BATCH_SIZE)
+    {
+        text_measure_batch_t * batch = g_slice_new(text_measure_batch_t);
+        batch->request = _request_ref(request);
+        batch->start = start;
+        batch->end = MIN(start + BATCH_SIZE, texts->len);
+        g_thread_pool_push(pool, batch, NULL);
+    }
+
+    return request;
+}
+
+void text_measure_request_cancel(TextMeasureRequest * request)
+{
+    g_atomic_int_set(&request->cancelled, 1);
+    _request_unref(request);
+}
@@ -0,0 +1,56 @@
+/*
+ *      text-measure-pool.h
+ *
+ *      Copyright (c) 2026 Vadim Ushakov
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+
+#ifndef __TEXT_MEASURE_POOL_H__
+#define __TEXT_MEASURE_POOL_H__
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+/*
+    Measures labels on a pool of worker threads. Every worker owns its
+    font map and PangoLayout, set up like the layout the request was made
+    from. When all batches of a request are done, the results are stored
+    in the text extents cache from the main loop, and the done callback
+    is called there.
+*/
+
+typedef struct _TextMeasureRequest TextMeasureRequest;
+
+typedef void (*TextMeasureDoneFunc)(gpointer user_data);
+
+/* Pango can only be used from several threads since 1.32. */
+gboolean text_measure_pool_is_available(void);
+
+/* Takes texts over. The width, height, wrapping and font settings of
+   layout are copied, so layout may be changed right away.
+   The request is freed after done returns. */
+TextMeasureRequest * text_measure_request_new(PangoLayout * layout, const char * font_key,
+    GPtrArray * texts, TextMeasureDoneFunc done, gpointer user_data);
+
+/* Frees the request; done is not called. */
+void text_measure_request_cancel(TextMeasureRequest * request);
+
+G_END_DECLS
+
+#endif /* __TEXT_MEASURE_POOL_H__ */
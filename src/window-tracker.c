@@ -26,6 +26,7 @@
 
 #include "pcmanfm.h"
 #include "app-config.h"
+#include "rect-batch.h"
 
 static GdkFilterReturn _event_filter(GdkXEvent *xevent, GdkEvent *event, gpointer not_used);
 
@@ -43,6 +44,11 @@ typedef struct _window_t
 
 static GSList * window_list = NULL;
 
+/* rects of the windows icons should not overlap, packed for rect_batch_intersect() */
+static GArray * overlap_rects = NULL;
+static GArray * overlap_hits = NULL;
+static gboolean overlap_rects_stale = TRUE;
+
 
 static guint emit_signal_idle_cb = 0;
 
@@ -55,6 +61,7 @@ static gboolean emit_signal_real(void)
 
 static void emit_signal(void)
 {
+    overlap_rects_stale = TRUE;
     if (!emit_signal_idle_cb)
         emit_signal_idle_cb = g_idle_add((GSourceFunc)emit_signal_real, NULL);
 }
@@ -251,32 +258,62 @@ void fm_window_tracker_initialize(void)
 void fm_window_tracker_finalize(void)
 {
     gdk_window_remove_filter(NULL, (GdkFilterFunc)_event_filter, NULL);
+
+    if (overlap_rects)
+    {
+        g_array_free(overlap_rects, TRUE);
+        g_array_free(overlap_hits, TRUE);
+        overlap_rects = overlap_hits = NULL;
+        overlap_rects_stale = TRUE;
+    }
+}
+
+static void collect_overlap_rect(GdkRectangle * rect, gpointer user_data)
+{
+    g_array_append_val(overlap_rects, *rect);
 }
 
 gboolean fm_window_tracker_test_overlap(GdkRectangle * rect)
 {
+    guint32 * hits;
+    guint i;
+
+    if (!overlap_rects)
+    {
+        overlap_rects = g_array_new(FALSE, FALSE, sizeof(GdkRectangle));
+        overlap_hits = g_array_new(FALSE, FALSE, sizeof(guint32));
+    }
+
+    if (overlap_rects_stale)
+    {
+        g_array_set_size(overlap_rects, 0);
+        fm_window_tracker_foreach_overlap_rect(collect_overlap_rect, NULL);
+        g_array_set_size(overlap_hits, RECT_BATCH_MASK_WORDS(overlap_rects->len));
+        overlap_rects_stale = FALSE;
+    }
+
+    if (overlap_rects->len == 0)
+        return FALSE;
 
+    hits = (guint32 *) overlap_hits->data;
+    rect_batch_intersect((GdkRectangle *) overlap_rects->data, overlap_rects->len, rect, hits);
+    for (i = 0; i < overlap_hits->len; i++)
+    {
+        if (hits[i])
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+void fm_window_tracker_foreach_overlap_rect(FmWindowTrackerRectFunc func, gpointer user_data)
+{
     GSList * l;
     for (l = window_list; l; l = l->next)
     {
         window_t * window = (window_t *) l->data;
-
         if (window->used && window->dont_overlap_desktop_icons)
-        {
-            if (gdk_rectangle_intersect(rect, &window->rect, NULL))
-            {
-/*
-                g_debug("xid = %d: %d:%d-%d:%d overlaps %d:%d-%d:%d", (int)window->xid,
-                    (int)window->rect.x, (int)window->rect.y,
-                    (int)window->rect.width, (int)window->rect.height,
-                    (int)rect->x, rect->y,
-                    (int)rect->width, rect->height);
-*/
-                return TRUE;
-            }
-        }
+            func(&window->rect, user_data);
     }
-
-    return FALSE;
 }
 
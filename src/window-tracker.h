@@ -29,6 +29,11 @@ void fm_window_tracker_finalize(void);
 
 gboolean fm_window_tracker_test_overlap(GdkRectangle * rect);
 
+typedef void (*FmWindowTrackerRectFunc)(GdkRectangle * rect, gpointer user_data);
+
+/* calls func for the rect of every window desktop icons should not overlap */
+void fm_window_tracker_foreach_overlap_rect(FmWindowTrackerRectFunc func, gpointer user_data);
+
 
 G_END_DECLS
 